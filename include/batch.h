@@ -0,0 +1,23 @@
+#pragma once
+
+#include "compiled_grammar.h"
+#include "lexer.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::istream;
+using std::ostream;
+using std::string;
+using std::vector;
+
+// recognizes every input, results are in the order of the inputs whatever
+// the number of threads is; threads_number = 0 means one per hardware thread.
+// Inputs are split into tokens by the lexer, without it every character is a token
+vector<bool> recognizeBatch(const CompiledGrammar& grammar, const vector<string>& inputs,
+		unsigned threads_number = 1, const Lexer* lexer = nullptr);
+
+// reads newline-delimited strings and writes 1 or 0 for each of them on its own line
+void recognizeLines(const CompiledGrammar& grammar, istream& input, ostream& output,
+		unsigned threads_number = 1, const Lexer* lexer = nullptr);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+using std::cout;
+using std::endl;
+using std::string;
+
+class BenchmarkRunner {
+public:
+  // runs func once and prints how long it took
+  template <class BenchmarkFunc>
+  double RunBenchmark(BenchmarkFunc func, const string& benchmark_name) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    auto finish = std::chrono::steady_clock::now();
+    double milliseconds =
+        std::chrono::duration<double, std::milli>(finish - start).count();
+    cout << benchmark_name << ": " << milliseconds << " ms" << endl;
+    return milliseconds;
+  }
+};
+
+#define RUN_BENCHMARK(br, func) \
+  br.RunBenchmark(func, #func)
@@ -0,0 +1,630 @@
+#pragma once
+
+#include "grammar.h"
+#include "chomsky_to_greybuh.h"
+#include "normalization.h"
+#include "earley.h"
+#include "compiled_grammar.h"
+#include "item_set.h"
+#include "benchmark_runner.h"
+#include "batch.h"
+#include "lexer.h"
+#include "parse_tree.h"
+#include "cyk.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+
+using std::string;
+using std::vector;
+using std::unordered_set;
+using std::to_string;
+using std::istringstream;
+
+// number of calls of the global operator new, defined in allocations.cpp
+extern std::atomic<size_t> allocations_number;
+
+Grammar getBracketGrammar() {
+	// the bracket grammar from input_examples.txt
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	grammar.addRule({"S'", {"S"}});
+	grammar.addRule({"S", {"(", "S", ")", "S"}});
+	grammar.addRule({"S", {}});
+	return grammar;
+}
+
+string getNestedBrackets(int pairs_number) {
+	string s;
+	for (int i = 0; i < pairs_number; ++i) {
+		s += (i % 2 == 0) ? "((" : "))";
+	}
+	return s;
+}
+
+// the hash chart columns used before ItemSet: it only looks at the origin
+// and at the dot position, so items of different rules collide
+struct LegacySituationHash {
+	const CompiledGrammar* grammar;
+
+	size_t operator () (const Situation& s) const {
+		uint32_t position = s.item - grammar->ruleFirstItem(grammar->itemRule(s.item));
+		size_t hash_1 = std::hash<int>()(s.deduced_prefix_length);
+		size_t hash_2 = std::hash<int>()(position);
+		return hash_1 ^ (hash_2 << 1);
+	}
+};
+
+// the columns of the chart of an input of input_examples.txt repeated, with the links kept:
+// that turns off Leo's optimization, so like before it the columns grow with the input
+vector<vector<Situation>> getBracketColumns(const CompiledGrammar& grammar, int repetitions_number) {
+	string input;
+	for (int i = 0; i < repetitions_number; ++i) {
+		input += "((()())(()())())";
+	}
+	EarleyAlgorithm earley_algorithm;
+	earley_algorithm.reset(grammar, true);
+	earley_algorithm.feed(input);
+	vector<vector<Situation>> columns;
+	for (size_t d = 0; d <= earley_algorithm.tokens().size(); ++d) {
+		columns.push_back(earley_algorithm.columnSituations(d));
+	}
+	return columns;
+}
+
+void benchmarkColumnContainers() {
+	BenchmarkRunner benchmark_runner;
+	CompiledGrammar grammar(getBracketGrammar());
+	LegacySituationHash legacy_hash{&grammar};
+	for (int repetitions_number : {100, 1000, 2000}) {
+		vector<vector<Situation>> columns = getBracketColumns(grammar, repetitions_number);
+		size_t situations_number = 0;
+		size_t biggest_column = 0;
+		for (const auto& situations : columns) {
+			situations_number += situations.size();
+			biggest_column = std::max(biggest_column, situations.size());
+		}
+		string suffix = " columns: " + to_string(columns.size()) + " of up to " +
+				to_string(biggest_column) + " situations, " + to_string(situations_number) + " in all";
+		size_t found = 0;
+		benchmark_runner.RunBenchmark([&] {
+			for (const auto& situations : columns) {
+				unordered_set<Situation, LegacySituationHash> column(0, legacy_hash);
+				for (const auto& situation : situations) {
+					column.insert(situation);
+				}
+				for (const auto& situation : situations) {
+					found += column.count(situation);
+				}
+			}
+		}, "unordered_set" + suffix);
+		benchmark_runner.RunBenchmark([&] {
+			for (const auto& situations : columns) {
+				ItemSet column;
+				for (const auto& situation : situations) {
+					column.insert(packSituation(situation));
+				}
+				for (const auto& situation : situations) {
+					found += column.contains(packSituation(situation));
+				}
+			}
+		}, "ItemSet" + suffix);
+		if (found != 2 * situations_number) {
+			cout << "column containers lost situations" << endl;
+		}
+	}
+}
+
+void benchmarkBracketRecognition() {
+	BenchmarkRunner benchmark_runner;
+	Grammar grammar = getBracketGrammar();
+	for (int length : {1000, 2000, 4000}) {
+		string s = getNestedBrackets(length / 2);
+		benchmark_runner.RunBenchmark([&] {
+			EarleyAlgorithm().isRecognized(grammar, s);
+		}, "bracket sequence of length " + to_string(length));
+	}
+}
+
+Grammar getWordsGrammar() {
+	// a sequence of one or two letter words: every column expects every letter
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	grammar.addRule({"S'", {"S"}});
+	grammar.addRule({"S", {"S", "W"}});
+	grammar.addRule({"S", {"W"}});
+	for (char letter = 'a'; letter <= 'z'; ++letter) {
+		grammar.addRule({"W", {string(1, letter)}});
+		grammar.addRule({"W", {string(1, letter), string(1, letter)}});
+	}
+	return grammar;
+}
+
+void benchmarkWideColumns() {
+	BenchmarkRunner benchmark_runner;
+	Grammar grammar = getWordsGrammar();
+	for (int length : {10000, 100000}) {
+		string s;
+		for (int i = 0; i < length; ++i) {
+			s += static_cast<char>('a' + (i * 7) % 26);
+		}
+		benchmark_runner.RunBenchmark([&] {
+			EarleyAlgorithm().isRecognized(grammar, s);
+		}, "words of letters, length " + to_string(length));
+	}
+}
+
+void benchmarkRightRecursion() {
+	// S--->( S ) S is right recursive: without Leo's optimization every ')' completes
+	// a chain of situations as long as the prefix, so time grows quadratically
+	BenchmarkRunner benchmark_runner;
+	Grammar grammar = getBracketGrammar();
+	for (int length : {10000, 100000, 1000000}) {
+		string s = getNestedBrackets(length / 2);
+		benchmark_runner.RunBenchmark([&] {
+			EarleyAlgorithm().isRecognized(grammar, s);
+		}, "right recursive bracket sequence of length " + to_string(length));
+	}
+}
+
+void benchmarkManyShortStrings() {
+	BenchmarkRunner benchmark_runner;
+	Grammar grammar = getWordsGrammar();
+	vector<string> strings;
+	for (int i = 0; i < 100000; ++i) {
+		strings.push_back(string(1, 'a' + i % 26) + string(1, 'a' + i % 7));
+	}
+	benchmark_runner.RunBenchmark([&] {
+		EarleyAlgorithm earley_algorithm;
+		for (const auto& s : strings) {
+			earley_algorithm.isRecognized(grammar, s);
+		}
+	}, "100000 short strings, grammar compiled for every string");
+	benchmark_runner.RunBenchmark([&] {
+		CompiledGrammar compiled_grammar(grammar);
+		EarleyAlgorithm earley_algorithm;
+		for (const auto& s : strings) {
+			earley_algorithm.isRecognized(compiled_grammar, s);
+		}
+	}, "100000 short strings, grammar compiled once");
+}
+
+void benchmarkBatchThreads() {
+	BenchmarkRunner benchmark_runner;
+	CompiledGrammar compiled_grammar(getBracketGrammar());
+	vector<string> strings;
+	for (int i = 0; i < 20000; ++i) {
+		strings.push_back(getNestedBrackets(10 + i % 40));
+	}
+	for (unsigned threads_number : {1, 2, 4, 8, 16, 32}) {
+		double milliseconds = benchmark_runner.RunBenchmark([&] {
+			recognizeBatch(compiled_grammar, strings, threads_number);
+		}, "20000 bracket strings, " + to_string(threads_number) + " threads");
+		cout << "  " << static_cast<long long>(strings.size() * 1000 / milliseconds)
+				<< " strings/sec" << endl;
+	}
+}
+
+void benchmarkChartAllocations() {
+	CompiledGrammar bracket_grammar(getBracketGrammar());
+	CompiledGrammar words_grammar(getWordsGrammar());
+	vector<string> brackets;
+	vector<string> words;
+	for (int i = 0; i < 10000; ++i) {
+		brackets.push_back(getNestedBrackets(10 + i % 40));
+		words.push_back(string(1, 'a' + i % 26) + string(1, 'a' + i % 7));
+	}
+	auto countAllocations = [](const CompiledGrammar& grammar, const vector<string>& strings,
+			const string& name) {
+		EarleyAlgorithm earley_algorithm;
+		// the first recognitions may allocate chart storage the later ones reuse
+		for (int i = 0; i < 100; ++i) {
+			earley_algorithm.isRecognized(grammar, strings[i]);
+		}
+		size_t allocations_before = allocations_number.load();
+		for (const auto& s : strings) {
+			earley_algorithm.isRecognized(grammar, s);
+		}
+		cout << name << ": " << static_cast<double>(allocations_number.load() - allocations_before) /
+				strings.size() << " allocations per string" << endl;
+	};
+	countAllocations(bracket_grammar, brackets, "10000 bracket strings");
+	countAllocations(words_grammar, words, "10000 short strings");
+}
+
+void benchmarkEditing() {
+	BenchmarkRunner benchmark_runner;
+	CompiledGrammar compiled_grammar(getWordsGrammar());
+	string document;
+	for (int i = 0; i < 100000; ++i) {
+		document += static_cast<char>('a' + (i * 7) % 26);
+	}
+	EarleyAlgorithm earley_algorithm;
+	benchmark_runner.RunBenchmark([&] {
+		earley_algorithm.reset(compiled_grammar);
+		earley_algorithm.feed(document);
+	}, "100 KB document, full recognition");
+	benchmark_runner.RunBenchmark([&] {
+		for (int i = 0; i < 1000; ++i) {
+			earley_algorithm.edit(earley_algorithm.tokens().size(), 0, "x");
+		}
+	}, "100 KB document, 1000 characters typed at the end");
+	benchmark_runner.RunBenchmark([&] {
+		for (int i = 0; i < 1000; ++i) {
+			earley_algorithm.edit(50000 + i, 1, "x");
+		}
+	}, "100 KB document, 1000 characters overwritten in the middle");
+	benchmark_runner.RunBenchmark([&] {
+		for (int i = 0; i < 10; ++i) {
+			earley_algorithm.edit(50000 + i, 0, "x");
+		}
+	}, "100 KB document, 10 characters inserted in the middle");
+}
+
+Grammar getStatementsGrammar(bool multi_character_terminals) {
+	// statements over a few keywords and identifiers; without multi-character
+	// terminals every keyword is spelled letter by letter
+	auto symbols = [multi_character_terminals](const vector<string>& tokens) {
+		vector<string> result;
+		for (const string& token : tokens) {
+			string text = terminalText(token);
+			if (multi_character_terminals || text == token || text.size() == 1) {
+				result.push_back(token);
+				continue;
+			}
+			for (char c : text) {
+				result.push_back(string(1, c));
+			}
+		}
+		return result;
+	};
+	Grammar grammar;
+	grammar.setStartingSymbol("P");
+	grammar.addRule({"P", {"P", "T"}});
+	grammar.addRule({"P", {"T"}});
+	grammar.addRule({"T", symbols({"\"while\"", "E", "\"do\"", "T"})});
+	grammar.addRule({"T", symbols({"I", "\"=\"", "E", "\";\""})});
+	grammar.addRule({"E", {"I"}});
+	grammar.addRule({"E", {"I", "\"+\"", "E"}});
+	grammar.addRule({"E", {"I", "\"<\"", "I"}});
+	for (string identifier : {"count", "total", "index"}) {
+		grammar.addRule({"I", symbols({"\"" + identifier + "\""})});
+	}
+	return grammar;
+}
+
+void benchmarkTokens() {
+	BenchmarkRunner benchmark_runner;
+	CompiledGrammar characters_grammar(getStatementsGrammar(false));
+	CompiledGrammar tokens_grammar(getStatementsGrammar(true));
+	string program;
+	for (int i = 0; i < 10000; ++i) {
+		// the spelled out grammar has no whitespace, the lexer doesn't need it either
+		program += (i % 2 == 0) ? "whilecount<totaldoindex=index+count;" : "total=total+index;";
+	}
+	EarleyAlgorithm earley_algorithm;
+	benchmark_runner.RunBenchmark([&] {
+		earley_algorithm.isRecognized(characters_grammar, program);
+	}, to_string(program.size()) + " characters of statements, one column per character");
+	vector<int> tokens;
+	LongestMatchLexer().tokenize(tokens_grammar, program, tokens);
+	benchmark_runner.RunBenchmark([&] {
+		LongestMatchLexer().tokenize(tokens_grammar, program, tokens);
+		earley_algorithm.isRecognized(tokens_grammar, tokens);
+	}, "the same program as " + to_string(tokens.size()) + " tokens, lexing included");
+}
+
+// a machine-generated grammar: rules_number rules over rules_number / 10 nonterminals,
+// in the input format of operator >> for Grammar
+string getGeneratedGrammarText(int rules_number) {
+	int nonterminals_number = std::max(rules_number / 10, 1);
+	string text = "N0 " + to_string(rules_number) + "\n";
+	for (int i = 0; i < rules_number; ++i) {
+		text += "N" + to_string(i % nonterminals_number) + " 3 " +
+				string(1, 'a' + i % 26) + " N" + to_string((i * 7 + 1) % nonterminals_number) +
+				" N" + to_string(i / 26 % nonterminals_number) + "\n";
+	}
+	return text;
+}
+
+void benchmarkGrammarLoading() {
+	BenchmarkRunner benchmark_runner;
+	for (int rules_number : {1000, 10000, 100000}) {
+		string text = getGeneratedGrammarText(rules_number);
+		Grammar grammar;
+		benchmark_runner.RunBenchmark([&] {
+			istringstream input(text);
+			input >> grammar;
+		}, "loading a grammar of " + to_string(rules_number) + " rules");
+		Grammar same_grammar = grammar;
+		benchmark_runner.RunBenchmark([&] {
+			bool equal = grammar == same_grammar;
+			(void)equal;
+		}, "comparing grammars of " + to_string(rules_number) + " rules");
+	}
+}
+
+void benchmarkCompiledGrammarLoading() {
+	BenchmarkRunner benchmark_runner;
+	const string file_name = "benchmark_compiled_grammar.bin";
+	for (int rules_number : {10000, 100000}) {
+		string text = getGeneratedGrammarText(rules_number);
+		benchmark_runner.RunBenchmark([&] {
+			Grammar grammar;
+			istringstream input(text);
+			input >> grammar;
+			CompiledGrammar(grammar).save(file_name);
+		}, "reading and compiling a text grammar of " + to_string(rules_number) + " rules");
+		benchmark_runner.RunBenchmark([&] {
+			CompiledGrammar::load(file_name);
+		}, "loading the compiled grammar of " + to_string(rules_number) + " rules");
+	}
+	std::remove(file_name.c_str());
+}
+
+void benchmarkParseForest() {
+	BenchmarkRunner benchmark_runner;
+	CompiledGrammar words_grammar(getWordsGrammar());
+	string words;
+	for (int i = 0; i < 100000; ++i) {
+		words += static_cast<char>('a' + (i * 7) % 26);
+	}
+	EarleyAlgorithm earley_algorithm;
+	benchmark_runner.RunBenchmark([&] {
+		earley_algorithm.isRecognized(words_grammar, words);
+	}, "words of letters, length 100000, recognition");
+	benchmark_runner.RunBenchmark([&] {
+		earley_algorithm.reset(words_grammar, true);
+		earley_algorithm.feed(words);
+		ParseForest forest = earley_algorithm.parseForest();
+		cout << forest.nodesNumber() << " nodes, " << forest.packedNodesNumber() << " packed nodes"
+				<< endl;
+	}, "words of letters, length 100000, parse forest");
+
+	// S--->S S: the number of trees is exponential, the forest is cubic
+	Grammar pairs;
+	pairs.setStartingSymbol("S");
+	pairs.addRule({"S", {"S", "S"}});
+	pairs.addRule({"S", {"a"}});
+	CompiledGrammar pairs_grammar(pairs);
+	for (int length : {50, 100, 200}) {
+		benchmark_runner.RunBenchmark([&] {
+			earley_algorithm.reset(pairs_grammar, true);
+			earley_algorithm.feed(string(length, 'a'));
+			ParseForest forest = earley_algorithm.parseForest();
+			cout << forest.nodesNumber() << " nodes, " << forest.packedNodesNumber() << " packed nodes"
+					<< endl;
+		}, "parse forest of S--->S S, length " + to_string(length));
+	}
+}
+
+void benchmarkParseTrees() {
+	BenchmarkRunner benchmark_runner;
+	EarleyAlgorithm earley_algorithm;
+	// S--->S S of 200 letters has more trees than fit in 64 bits
+	Grammar pairs;
+	pairs.setStartingSymbol("S");
+	pairs.addRule({"S", {"S", "S"}});
+	pairs.addRule({"S", {"a"}});
+	CompiledGrammar pairs_grammar(pairs);
+	earley_algorithm.reset(pairs_grammar, true);
+	earley_algorithm.feed(string(200, 'a'));
+	ParseForest forest = earley_algorithm.parseForest();
+	benchmark_runner.RunBenchmark([&] {
+		cout << countTrees(forest) << " trees" << endl;
+	}, "counting trees of S--->S S, length 200");
+	benchmark_runner.RunBenchmark([&] {
+		TreeEnumerator trees(pairs_grammar, forest);
+		ParseTree tree;
+		int trees_number = 0;
+		while (trees_number < 10000 && trees.next(tree)) {
+			++trees_number;
+		}
+		cout << trees_number << " trees of " << tree.nodesNumber() << " nodes" << endl;
+	}, "first 10000 trees of S--->S S, length 200");
+	for (int k : {1, 100}) {
+		benchmark_runner.RunBenchmark([&] {
+			vector<ParseTree> trees = bestTrees(pairs_grammar, forest, {1, 0}, k);
+			cout << trees.size() << " trees" << endl;
+		}, to_string(k) + " best trees of S--->S S, length 200");
+	}
+
+	CompiledGrammar words_grammar(getWordsGrammar());
+	string words;
+	for (int i = 0; i < 100000; ++i) {
+		words += static_cast<char>('a' + (i * 7) % 26);
+	}
+	earley_algorithm.reset(words_grammar, true);
+	earley_algorithm.feed(words);
+	forest = earley_algorithm.parseForest();
+	benchmark_runner.RunBenchmark([&] {
+		TreeEnumerator trees(words_grammar, forest);
+		ParseTree tree;
+		trees.next(tree);
+		cout << tree.nodesNumber() << " nodes" << endl;
+	}, "the tree of words of letters, length 100000");
+}
+
+// Chomsky form in blocks of 8 nonterminals: the left children of a block are
+// the next nonterminals of the block, the right children are from other blocks
+Grammar getChomskyGrammar(int blocks_number) {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	auto nonterminal = [](int block, int i) {
+		return "N" + to_string(block) + "_" + to_string(i);
+	};
+	grammar.addRule({"S", {nonterminal(0, 0), nonterminal(1 % blocks_number, 0)}});
+	for (int block = 0; block < blocks_number; ++block) {
+		grammar.addRule({nonterminal(block, 0), {nonterminal(block, 0), nonterminal((block * 5 + 3) % blocks_number, 0)}});
+		for (int i = 0; i < 7; ++i) {
+			grammar.addRule({nonterminal(block, i), {nonterminal(block, i + 1), nonterminal((block * 7 + i + 1) % blocks_number, 0)}});
+			grammar.addRule({nonterminal(block, i), {nonterminal(block, i + 1), nonterminal((block * 3 + i) % blocks_number, 7)}});
+		}
+		grammar.addRule({nonterminal(block, 7), {string(1, 'a' + block % 26)}});
+		grammar.addRule({nonterminal(block, 7), {string(1, 'a' + (block + 13) % 26)}});
+	}
+	return grammar;
+}
+
+void benchmarkChomskyToGreybuh() {
+	BenchmarkRunner benchmark_runner;
+	for (int blocks_number : {10, 100, 1000}) {
+		Grammar grammar = getChomskyGrammar(blocks_number);
+		for (unsigned threads_number : {1u, 0u}) {
+			benchmark_runner.RunBenchmark([&] {
+				Grammar greibach_grammar = chomskyToGreybuh(grammar, threads_number);
+				cout << greibach_grammar.rules.size() << " rules" << endl;
+			}, "Greibach form of " + to_string(grammar.rules.size()) + " rules, " +
+					(threads_number == 1 ? "1 thread" : "every hardware thread"));
+		}
+	}
+}
+
+void benchmarkNormalization() {
+	BenchmarkRunner benchmark_runner;
+	for (int rules_number : {10000, 100000}) {
+		// the generated rules with a terminal, an epsilon or a unit rule for some nonterminals
+		Grammar grammar;
+		istringstream input(getGeneratedGrammarText(rules_number));
+		input >> grammar;
+		int nonterminals_number = grammar.symbols.size();
+		for (int i = 0; i < nonterminals_number; ++i) {
+			string nonterminal = "N" + to_string(i);
+			grammar.addRule({nonterminal, {string(1, 'a' + i % 26)}});
+			if (i % 5 == 0) {
+				grammar.addRule({nonterminal, {"epsilon"}});
+			}
+			if (i % 4 == 0) {
+				grammar.addRule({nonterminal, {"N" + to_string((i * 3 + 1) % nonterminals_number)}});
+			}
+		}
+		vector<pair<string, GrammarSize>> pass_sizes;
+		benchmark_runner.RunBenchmark([&] {
+			toChomskyForm(grammar, &pass_sizes);
+		}, "Chomsky form of " + to_string(grammar.rules.size()) + " rules");
+		for (const auto& pass_size : pass_sizes) {
+			cout << "  " << pass_size.first << ": " << pass_size.second << endl;
+		}
+	}
+}
+
+// a random Chomsky grammar where most pairs of nonterminals have a rule, so cells
+// of long spans hold most nonterminals: CYK's worst case
+Grammar getDenseChomskyGrammar(int nonterminals_number) {
+	Grammar grammar;
+	grammar.setStartingSymbol("N0");
+	unsigned random_state = 12345;
+	auto random = [&random_state](unsigned bound) {
+		random_state = random_state * 1103515245 + 12345;
+		return (random_state >> 16) % bound;
+	};
+	for (int A = 0; A < nonterminals_number; ++A) {
+		string from = "N" + to_string(A);
+		grammar.addRule({from, {string(1, 'a' + A % 4)}});
+		for (int i = 0; i < 2 * nonterminals_number; ++i) {
+			grammar.addRule({from, {"N" + to_string(random(nonterminals_number)),
+					"N" + to_string(random(nonterminals_number))}});
+		}
+	}
+	return grammar;
+}
+
+Grammar getAmbiguousGrammar() {
+	// S--->S S | a: every split of every span is a derivation, the worst case of Earley too
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"S", "S"}});
+	grammar.addRule({"S", {"a"}});
+	return grammar;
+}
+
+void benchmarkCyk() {
+	BenchmarkRunner benchmark_runner;
+	Grammar ambiguous = getAmbiguousGrammar();
+	CykGrammar cyk_ambiguous(ambiguous);
+	CompiledGrammar compiled_ambiguous(ambiguous);
+	for (int length : {100, 200, 400}) {
+		string s(length, 'a');
+		benchmark_runner.RunBenchmark([&] {
+			CykAlgorithm().isRecognized(cyk_ambiguous, s);
+		}, "CYK, S--->S S | a, length " + to_string(length));
+		benchmark_runner.RunBenchmark([&] {
+			EarleyAlgorithm().isRecognized(compiled_ambiguous, s);
+		}, "Earley, S--->S S | a, length " + to_string(length));
+	}
+
+	// brackets are nearly linear for Earley, but CYK fills the whole table anyway
+	Grammar brackets = getBracketGrammar();
+	CykGrammar cyk_brackets(toChomskyForm(brackets));
+	CompiledGrammar compiled_brackets(brackets);
+	for (int length : {200, 400, 800}) {
+		string s = getNestedBrackets(length / 2);
+		benchmark_runner.RunBenchmark([&] {
+			CykAlgorithm().isRecognized(cyk_brackets, s);
+		}, "CYK, bracket sequence of length " + to_string(length));
+		benchmark_runner.RunBenchmark([&] {
+			EarleyAlgorithm().isRecognized(compiled_brackets, s);
+		}, "Earley, bracket sequence of length " + to_string(length));
+	}
+
+	for (int nonterminals_number : {8, 16}) {
+		Grammar dense = getDenseChomskyGrammar(nonterminals_number);
+		CykGrammar cyk_dense(dense);
+		CompiledGrammar compiled_dense(dense);
+		string s;
+		for (int i = 0; i < 60; ++i) {
+			s += static_cast<char>('a' + (i * 7) % 4);
+		}
+		string suffix = " nonterminals, " + to_string(dense.rules.size()) + " rules, length 60";
+		benchmark_runner.RunBenchmark([&] {
+			CykAlgorithm().isRecognized(cyk_dense, s);
+		}, "CYK, dense grammar of " + to_string(nonterminals_number) + suffix);
+		benchmark_runner.RunBenchmark([&] {
+			EarleyAlgorithm().isRecognized(compiled_dense, s);
+		}, "Earley, dense grammar of " + to_string(nonterminals_number) + suffix);
+	}
+}
+
+void benchmarkCykThreads() {
+	// one long input, the tiles of a diagonal of the table are split between the threads.
+	// Cells of S--->S S | a are full after one split, brackets try every split of a span
+	BenchmarkRunner benchmark_runner;
+	CykGrammar cyk_ambiguous(getAmbiguousGrammar());
+	CykGrammar cyk_brackets(toChomskyForm(getBracketGrammar()));
+	string ambiguous_input(20000, 'a');
+	string brackets_input = getNestedBrackets(1000);
+	for (unsigned threads_number : {1, 2, 4, 8}) {
+		CykAlgorithm cyk_algorithm(threads_number);
+		benchmark_runner.RunBenchmark([&] {
+			cyk_algorithm.isRecognized(cyk_ambiguous, ambiguous_input);
+		}, "CYK, S--->S S | a, length 20000, " + to_string(threads_number) + " threads");
+		benchmark_runner.RunBenchmark([&] {
+			cyk_algorithm.isRecognized(cyk_brackets, brackets_input);
+		}, "CYK, bracket sequence of length 2000, " + to_string(threads_number) + " threads");
+	}
+}
+
+void runBenchmarks() {
+	benchmarkColumnContainers();
+	benchmarkBracketRecognition();
+	benchmarkRightRecursion();
+	benchmarkWideColumns();
+	benchmarkManyShortStrings();
+	benchmarkBatchThreads();
+	benchmarkChartAllocations();
+	benchmarkEditing();
+	benchmarkTokens();
+	benchmarkGrammarLoading();
+	benchmarkCompiledGrammarLoading();
+	benchmarkParseForest();
+	benchmarkParseTrees();
+	benchmarkChomskyToGreybuh();
+	benchmarkNormalization();
+	benchmarkCyk();
+	benchmarkCykThreads();
+}
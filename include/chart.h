@@ -0,0 +1,160 @@
+#pragma once
+
+#include "item_set.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using std::ostream;
+using std::vector;
+
+struct Situation {
+	uint32_t item; // dotted rule, index in the item table of the compiled grammar
+	uint32_t deduced_prefix_length; // standart notation
+};
+
+static_assert(sizeof(Situation) == 8, "situations are packed into 64-bit keys");
+
+ostream& operator << (ostream& os, const Situation& s);
+bool operator == (const Situation& s1, const Situation& s2);
+
+// situations are hashed as 64-bit keys: origin in the high half, item in the low one
+uint64_t packSituation(const Situation& s);
+Situation unpackSituation(uint64_t key);
+
+// all columns of the Earley chart in one buffer of parallel arrays: the situations
+// of column d are at positions [columnBegin(d), columnEnd(d)), so columns are walked
+// linearly and nothing is allocated per column. Only the last column is extended,
+// so only it has a table for deduplication. Situations waiting for the same symbol
+// in a column are chained together, so completion only visits the relevant ones
+class Chart {
+public:
+	uint32_t columnsNumber() const {
+		return columns_.size();
+	}
+	uint32_t columnBegin(int d_number) const {
+		return columns_[d_number].begin;
+	}
+	uint32_t columnEnd(int d_number) const {
+		return columns_[d_number].end;
+	}
+	uint32_t columnSize(int d_number) const {
+		return columns_[d_number].end - columns_[d_number].begin;
+	}
+
+	// keeps the memory, so the next recognition doesn't allocate
+	void clear();
+	// opens a new last column, the previous one can't be extended any more
+	void addColumn();
+
+	// columns after an edit position are detached while the edit is rebuilt: their
+	// situations stay in the buffer, so they can be compared with the rebuilt columns
+	// and reattached without copying. Detached column j is the column first_column + j
+	void detach(int first_column);
+	uint32_t detachedBegin(int j) const {
+		return detached_[j].begin;
+	}
+	uint32_t detachedEnd(int j) const {
+		return detached_[j].end;
+	}
+	// appends the detached columns starting from first_detached with origins greater
+	// than origin_threshold shifted by shift, the other detached columns are dropped
+	void reattach(int first_detached, int origin_threshold, int shift);
+
+	// adds the situation to the last column; next_symbol is the symbol the situation
+	// waits for, -1 if it shouldn't be indexed; returns true if the situation is new
+	bool insert(const Situation& situation, int next_symbol);
+	// whether the last column contains the situation
+	bool contains(const Situation& situation) const;
+
+	Situation operator [] (uint32_t position) const {
+		return Situation{items_[position], origins_[position]};
+	}
+	uint32_t item(uint32_t position) const {
+		return items_[position];
+	}
+	uint32_t origin(uint32_t position) const {
+		return origins_[position];
+	}
+
+	static constexpr uint32_t npos = ItemSet::npos;
+	// positions of the situations waiting for the symbol in the column in insertion
+	// order, both return npos when there are no more of them
+	uint32_t firstWaiting(int d_number, int symbol) const;
+	// the same as firstWaiting, but only for the first call while the last column is
+	// extended: completing the symbol again adds nothing new to it
+	uint32_t firstWaitingOnce(int d_number, int symbol);
+	uint32_t nextWaiting(uint32_t position) const {
+		return next_waiting_[position];
+	}
+	// chains a situation which wasn't indexed on insertion after another one
+	void link(uint32_t position, uint32_t next_position) {
+		next_waiting_[position] = next_position;
+	}
+
+	// memo for Leo's optimization: packed topmost situation of the deterministic
+	// reduction path which starts by completing the symbol in the column
+	static constexpr uint64_t unknown_transitive = UINT64_MAX;
+	static constexpr uint64_t no_transitive = UINT64_MAX - 1;
+	// no_transitive for symbols nothing waits for
+	uint64_t transitive(int d_number, int symbol) const;
+	// the symbol must have waiting situations in the column
+	void setTransitive(int d_number, int symbol, uint64_t key);
+
+	// back-pointers for parse forests: a link of a situation is the situation of an
+	// earlier or the same column whose dot was moved to get it. Links are only
+	// stored if they are added, and aren't kept by detach and reattach
+	// adds a link to the situation at the position of the last column
+	void addLink(uint32_t position, uint32_t predecessor);
+	// position of the situation in the last column, npos if there is no such situation
+	uint32_t find(const Situation& situation) const;
+	// both return npos when there are no more links
+	uint32_t firstLink(uint32_t position) const {
+		return position < link_heads_.size() ? link_heads_[position] : npos;
+	}
+	uint32_t nextLink(uint32_t link) const {
+		return link_next_[link];
+	}
+	uint32_t linkPredecessor(uint32_t link) const {
+		return link_predecessors_[link];
+	}
+
+private:
+	// columns are ranges of the buffer and of the waiting pairs, in the order of
+	// positions but not necessarily adjacent: reattached columns leave holes
+	struct Column {
+		uint32_t begin;
+		uint32_t end;
+		uint32_t waiting_begin;
+		uint32_t waiting_end;
+		uint32_t id; // waiting pairs are keyed by it, so they survive renumbering
+	};
+
+	uint64_t waitingKey_(int d_number, int symbol) const {
+		return (static_cast<uint64_t>(columns_[d_number].id) << 32) | static_cast<uint32_t>(symbol);
+	}
+	void indexLastColumn_();
+	// copies the columns into a fresh buffer without the dropped ones
+	void compact_();
+
+	vector<uint32_t> items_;
+	vector<uint32_t> origins_;
+	vector<uint32_t> next_waiting_;
+	vector<Column> columns_;
+	vector<Column> detached_;
+	uint32_t next_column_id_ = 0;
+	uint32_t dropped_situations_ = 0; // situations of the buffer which belong to no column
+	ItemSet last_column_; // situations of the last column
+
+	// (column id, symbol) pairs which have waiting situations
+	ItemSet waiting_symbols_;
+	vector<uint32_t> waiting_heads_; // parallel to waiting_symbols_
+	vector<uint32_t> waiting_tails_;
+	vector<uint64_t> transitive_;
+	vector<uint32_t> completed_in_; // id of the last column the situations were completed into
+
+	vector<uint32_t> link_heads_; // parallel to the buffer, may be shorter
+	vector<uint32_t> link_next_;
+	vector<uint32_t> link_predecessors_;
+};
@@ -4,8 +4,12 @@
 
 Grammar removeEpsilon(const Grammar& grammar);
 // this function can only remove epsilon rules after the main
-// part of chomsky to greybuh algorithm
+// part of chomsky to greybuh algorithm, see normalization.h for other grammars
 
 int classifyRuleChomskyToGreybuh(const Rule& rule, const string& starting_symbol);
 void processRule(Grammar& grammar, const Rule& rule);
-Grammar chomskyToGreybuh(const Grammar& grammar);
+// the grammar has to be in Chomsky form, the result is in Greibach form with
+// nonterminals A\B for the words w such that B derives A w. Only useful rules are
+// made: those of reachable and productive nonterminals. threads_number = 0 means
+// one per hardware thread, the result doesn't depend on it
+Grammar chomskyToGreybuh(const Grammar& grammar, unsigned threads_number = 1);
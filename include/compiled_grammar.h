@@ -0,0 +1,122 @@
+#pragma once
+
+#include "grammar.h"
+#include "symbol_table.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+// everything the recognizer needs to know about a grammar, derived once:
+// interned symbols, rules as flat int arrays, the item table, nullable and
+// productive symbols, prediction closures and the augmented start rule. It is never modified after
+// construction, so one instance can be shared by any number of recognizers
+class CompiledGrammar {
+public:
+	explicit CompiledGrammar(const Grammar& grammar);
+
+	// the binary format holds every table, so loading reads them straight into their
+	// vectors and only the symbol table is rebuilt from the names; it depends on the
+	// byte order and changes with the version.
+	// Both throw runtime_error on files which can't be written or read
+	void save(const string& file_name) const;
+	static CompiledGrammar load(const string& file_name);
+
+	const SymbolTable& symbols() const {
+		return symbols_;
+	}
+	bool isTerminal(int symbol) const {
+		return symbols_.isTerminal(symbol);
+	}
+	bool isNullable(int symbol) const {
+		return nullable_[symbol];
+	}
+	// whether some string of terminals is derived from the symbol
+	bool isProductive(int symbol) const {
+		return productive_[symbol];
+	}
+	// terminal id of a single character terminal or -1
+	int characterSymbol(char c) const {
+		return character_symbols_[static_cast<unsigned char>(c)];
+	}
+	// terminal id of the token, the text of a quoted terminal, or -1
+	int terminalSymbol(const string& text) const;
+	// length of the longest terminal text
+	int maxTerminalLength() const {
+		return max_terminal_length_;
+	}
+
+	// rule r is ruleFrom(r) ---> ruleSymbol(r, 0) ... ruleSymbol(r, ruleLength(r) - 1)
+	int rulesNumber() const {
+		return rule_from_.size();
+	}
+	int ruleFrom(int rule_number) const {
+		return rule_from_[rule_number];
+	}
+	int ruleLength(int rule_number) const {
+		return rule_begin_[rule_number + 1] - rule_begin_[rule_number];
+	}
+	int ruleSymbol(int rule_number, int position) const {
+		return rule_symbols_[rule_begin_[rule_number] + position];
+	}
+	// S'--->S where S' is a new symbol and S is the starting symbol of the grammar
+	int startRule() const {
+		return start_rule_;
+	}
+
+	// item table: rule r with the dot before its p-th symbol is item ruleFirstItem(r) + p,
+	// so moving the dot is just an increment of the item
+	uint32_t ruleFirstItem(int rule_number) const {
+		return rule_first_item_[rule_number];
+	}
+	int itemRule(uint32_t item) const {
+		return item_rule_[item];
+	}
+	// -1 for completed items
+	int itemNextSymbol(uint32_t item) const {
+		return item_next_symbol_[item];
+	}
+
+	// initial items of all rules which are predicted together with the nonterminal;
+	// rules with unproductive symbols are never completed, so they are left out
+	const uint32_t* predictionBegin(int symbol) const {
+		return prediction_items_.data() + prediction_begin_[symbol];
+	}
+	const uint32_t* predictionEnd(int symbol) const {
+		return prediction_items_.data() + prediction_begin_[symbol + 1];
+	}
+
+private:
+	CompiledGrammar() = default;
+	// terminal texts are derived from the symbol table both after construction and loading
+	void computeTerminalSymbols_();
+	void computeItems_();
+	void computeNullable_();
+	void computeProductive_();
+	bool isProductiveRule_(int rule_number) const;
+	bool isConsistent_() const;
+	void computePredictionClosures_();
+
+	SymbolTable symbols_;
+	vector<int> rule_from_;
+	vector<int> rule_begin_;
+	vector<int> rule_symbols_;
+	int start_rule_ = -1;
+
+	vector<uint32_t> rule_first_item_;
+	vector<int> item_rule_;
+	vector<int> item_next_symbol_;
+
+	vector<bool> nullable_;
+	vector<bool> productive_;
+	vector<int> prediction_begin_;
+	vector<uint32_t> prediction_items_;
+	vector<int> character_symbols_;
+	unordered_map<string, int> terminal_symbols_;
+	int max_terminal_length_ = 0;
+};
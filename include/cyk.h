@@ -0,0 +1,136 @@
+#pragma once
+
+#include "grammar.h"
+#include "compiled_grammar.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// what the CYK algorithm needs to know about a grammar in Chomsky form:
+// sets of nonterminals are bitsets of wordsNumber() 64-bit words, for every
+// terminal the set of A with A--->a and for every B the rules A--->B C grouped
+// by C. Like CompiledGrammar it is never modified, so it can be shared
+class CykGrammar {
+public:
+	// both throw runtime_error if the grammar isn't in Chomsky form: every rule
+	// is A--->a, A--->B C or S--->epsilon with S in no right side, see toChomskyForm
+	explicit CykGrammar(const Grammar& grammar);
+	explicit CykGrammar(const CompiledGrammar& grammar);
+
+	// terminal ids of the tokens are those of the compiled grammar, see Lexer
+	const CompiledGrammar& compiledGrammar() const {
+		return grammar_;
+	}
+	int nonterminalsNumber() const {
+		return nonterminals_number_;
+	}
+	int wordsNumber() const {
+		return words_number_;
+	}
+
+private:
+	friend class CykAlgorithm;
+
+	const uint64_t* terminalSet_(int terminal) const {
+		return terminal_sets_.data() + static_cast<size_t>(terminal) * words_number_;
+	}
+	const uint64_t* rightChildren_(int B) const {
+		return right_children_.data() + static_cast<size_t>(B) * words_number_;
+	}
+	const uint64_t* heads_(int pair_number) const {
+		return pair_heads_.data() + static_cast<size_t>(pair_number) * words_number_;
+	}
+	const uint64_t* leftHeads_(int B) const {
+		return left_heads_.data() + static_cast<size_t>(B) * words_number_;
+	}
+
+	CompiledGrammar grammar_;
+	int nonterminals_number_ = 0;
+	int words_number_ = 0;
+	int start_ = 0; // nonterminal number of the starting symbol
+	bool accepts_empty_ = false;
+	vector<int> nonterminal_of_; // by symbol id, -1 for terminals
+	vector<uint64_t> terminal_sets_; // by terminal id
+	// pairs (B, C) of binary rules: those of B are [pairs_begin_[B], pairs_begin_[B + 1])
+	// in the order of C, so the pair of C is found by its rank in right_children_ of B.
+	// pair_heads_ is the set of A with A--->B C
+	vector<int> pairs_begin_;
+	vector<uint64_t> pair_heads_;
+	vector<uint64_t> right_children_; // by B: the set of C of its pairs
+	vector<uint64_t> left_heads_; // by B: the union of heads of its pairs
+	vector<uint64_t> left_children_; // the set of B with pairs
+	vector<uint64_t> binary_right_children_; // the set of C with pairs
+	vector<uint64_t> binary_heads_; // the union of heads of all pairs
+};
+
+// the Cocke-Younger-Kasami recognizer: the cell of a span of the input is the
+// set of nonterminals deriving it, made of the cells of the shorter spans with
+// word-wide AND and OR. O(n^3) for any grammar, but without Earley's situations.
+// The table is split into square tiles of spans, a tile depends only on the tiles
+// to the left of it and below it, so the tiles of one diagonal are independent and
+// are filled by several threads; threads_number = 0 means one per hardware thread
+class CykAlgorithm {
+public:
+	explicit CykAlgorithm(unsigned threads_number = 1);
+
+	bool isRecognized(const CykGrammar& grammar, const string& s);
+	bool isRecognized(const Grammar& grammar, const string& s);
+	// the input is a sequence of terminal ids, see Lexer; -1 is a token of no terminal
+	bool isRecognized(const CykGrammar& grammar, const vector<int>& tokens);
+
+private:
+	// tile (i, j) holds the spans with begin / tile_size = i and end / tile_size = j.
+	// The size is that of a word of the bitsets below: a tile owns whole words of them,
+	// and the splits of a word have their cells in two tiles
+	static const int tile_size = 64;
+
+	size_t tileNumber_(int begin_block, int end_block) const {
+		return static_cast<size_t>(end_block) * (end_block + 1) / 2 + begin_block;
+	}
+	// a filled tile is stored by nonterminals: for every A and every begin of the tile the word
+	// of the ends whose spans A derives. That is 512 bytes per nonterminal, while 64 x 64 cells
+	// take 32 KB per word of a set, so the table of S--->S S | a for 20000 tokens is 25 MB, not 1.6 GB
+	uint64_t tileRow_(int A, int begin, int end_block) const {
+		return tiles_[tileNumber_(begin / tile_size, end_block)][A * tile_size + begin % tile_size];
+	}
+	bool derives_(int A, int begin, int end) const {
+		return (tileRow_(A, begin, end / tile_size) >> (end % tile_size)) & 1;
+	}
+	// the nonterminals of the mask deriving the span, as a set of words_number_ words
+	void readCell_(int begin, int end, const uint64_t* mask, uint64_t* cell) const;
+	// bitsets of positions: for every begin the ends of its non-empty spans and for every end
+	// the begins of them, so the splits of a span with both cells non-empty are a word-wide AND
+	uint64_t* nonemptyEnds_(int begin) {
+		return nonempty_ends_.data() + static_cast<size_t>(begin) * positions_words_number_;
+	}
+	uint64_t* nonemptyBegins_(int end) {
+		return nonempty_begins_.data() + static_cast<size_t>(end) * positions_words_number_;
+	}
+
+	// fills the tiles (i, i + diagonal) taken from next_tile until none is left
+	void fillDiagonal_(const CykGrammar& grammar, const vector<int>& tokens, int diagonal,
+			std::atomic<int>& next_tile);
+	// fills the tile (i, j) in two phases. The splits in the blocks strictly between i and j
+	// have both cells in the tiles of previous diagonals, so they are a product of tiles (i, k)
+	// and (k, j) read row by row. The splits in blocks i and j have a cell in this tile, so the
+	// spans are then finished by end and by begin from right to left
+	void fillTile_(const CykGrammar& grammar, const vector<int>& tokens, int begin_block, int end_block,
+			vector<uint64_t>& scratch);
+
+	unsigned threads_number_;
+	// a tile is allocated once a span of it is non-empty, only spans marked as non-empty
+	// in the bitsets are read, so tiles are neither cleared nor freed between recognitions
+	vector<vector<uint64_t>> tiles_;
+	vector<uint64_t> nonempty_ends_;
+	vector<uint64_t> nonempty_begins_;
+	int tokens_number_ = 0;
+	int nonterminals_number_ = 0;
+	int words_number_ = 0;
+	int positions_words_number_ = 0;
+	int blocks_number_ = 0;
+};
@@ -1,50 +1,130 @@
 #pragma once
 
 #include "grammar.h"
+#include "compiled_grammar.h"
+#include "chart.h"
+#include "parse_forest.h"
 
 #include <vector>
-#include <unordered_set>
+#include <cstdint>
+#include <utility>
 
 using std::vector;
-using std::unordered_set;
-
-class Situation {
-public:
-	Situation(const Rule& rule, int deduced_prefix_length, int position_in_rule):
-			rule(rule), deduced_prefix_length(deduced_prefix_length),
-			position_in_rule(position_in_rule) {}
-	Rule rule;
-	int deduced_prefix_length = -1; // standart notation
-	int position_in_rule = 0;
-};
-
-ostream& operator << (ostream& os, const Situation& s);
-bool operator == (const Situation& s1, const Situation& s2);
-
-struct SituationHash {
-	size_t operator () (const Situation& s) const;
-};
+using std::pair;
 
 class EarleyAlgorithm {
 private:
-	vector<unordered_set<Situation, SituationHash>> D_situations_;
-	void initialize_(const Grammar& grammar, const string& s);
+	const CompiledGrammar* grammar_ = nullptr;
+	bool building_forest_ = false; // links of situations are recorded, see parseForest
+
+	// stamps of the current recognition are column_stamp_base_ + column number + 1,
+	// so the arrays indexed by symbol below are not cleared between recognitions
+	uint32_t column_stamp_base_ = 0;
+	vector<uint32_t> predicted_in_column_; // stamp of the column where the symbol was predicted
+	// situations of the column being closed which wait for a terminal are chained
+	// through it too, but the chain ends live here: scanning is done once per column,
+	// so a dense array indexed by terminal is enough and nothing is hashed
+	vector<uint32_t> scan_column_; // stamp of the column where the terminal's chain was started
+	vector<uint32_t> scan_head_;
+	vector<uint32_t> scan_tail_;
+	vector<pair<int, int>> leo_path_; // (column, symbol) pairs, scratch of transitiveSituation_
+
+	// the chart is only cleared between recognitions, never freed, so once it
+	// has grown to the biggest chart seen, recognition doesn't allocate
+	Chart D_situations_;
+	vector<int> tokens_; // terminal ids of the input fed so far
+	vector<bool> rebuilt_safe_; // for the columns after the edit position, see edit
+	// starts the chart with column 0 holding (S'->.S, 0)
+	void initialize_(const CompiledGrammar& grammar);
+	void advanceStamps_();
 	void finalize_();
 
-	bool predict_(int d_number, const Grammar& grammar, const string& s);
-	Situation predict_(const Rule& rule, int d_number);
+	uint32_t columnStamp_(int d_number) const {
+		return column_stamp_base_ + d_number + 1;
+	}
+	// returns -1 if the situation is completed
+	int nextSymbol_(const Situation& situation) const {
+		return grammar_->itemNextSymbol(situation.item);
+	}
+	int positionInRule_(const Situation& situation) const;
+	// predecessor is the situation the dot was moved in, it is linked to the inserted
+	// one when building a parse forest
+	bool insert_(int d_number, const Situation& situation, uint32_t predecessor = Chart::npos);
+	// appends a situation waiting for the terminal to the column's scan chain
+	void chainScan_(int d_number, int terminal, uint32_t position);
+	// rebuilds the scan chains of a column closed with other stamps
+	void rechainScans_(int d_number);
+
+	void processColumn_(int d_number);
+
+	void predict_(int d_number, uint32_t position);
+	Situation predict_(int rule_number, int d_number);
 
-	bool complete_(int d_number, const string& s);
+	void complete_(int d_number, const Situation& situation_j);
+	bool transitiveSituation_(int d_number, int symbol, Situation& top);
 	Situation complete_(const Situation& situation_k);
 
-	void scan_(int d_number, const string& s);
+	// scans column d_number, the last one, into a new column d_number + 1
+	void scan_(int d_number, int terminal);
 	Situation scan_(Situation situation);
+
+	// whether the last column, rebuilt after an edit at the position, is the old column
+	// old_d_number, whose situations are at [old_begin, old_end) of the chart
+	bool matchesOldColumn_(int d_number, uint32_t old_begin, uint32_t old_end, int old_d_number,
+			int position, int shift) const;
+	// whether the situations of the column which aren't completed (or only those waiting
+	// for nonterminals) start at unchanged columns, at safe rebuilt ones or at the column itself
+	bool reachesOnlySafeColumns_(int d_number, int position, bool waiting_for_nonterminals) const;
 public:
+	// the compiled grammar is only read, so it can be shared between recognizers
+	bool isRecognized(const CompiledGrammar& grammar, const string& s);
 	bool isRecognized(const Grammar& grammar, const string& s);
+	// the input is a sequence of terminal ids, see Lexer; -1 is a token of no terminal
+	bool isRecognized(const CompiledGrammar& grammar, const vector<int>& tokens);
+
+	// incremental recognition: reset starts from the empty prefix and every feed
+	// extends it, closing one chart column per token. isRecognized discards it.
+	// The grammar has to outlive the recognition. With building_forest, the chart
+	// keeps what parseForest needs and Leo's optimization is off, so right recursion
+	// is quadratic again; such inputs can't be edited
+	void reset(const CompiledGrammar& grammar, bool building_forest = false);
+	// all of them return isViablePrefix() for the extended prefix;
+	// characters are the tokens of their single character terminals
+	bool feedToken(int terminal);
+	bool feed(const vector<int>& tokens);
+	bool feed(char c);
+	bool feed(const string& s);
+	// whether the prefix fed so far can be continued to a recognized string
+	bool isViablePrefix() const;
+	// names of the terminals which keep the prefix viable, in the order of their ids
+	vector<string> expectedTerminals() const;
+	// whether the prefix fed so far is recognized itself
+	bool accepts() const;
+	const vector<int>& tokens() const {
+		return tokens_;
+	}
+	// the situations of column d_number, 0 <= d_number <= tokens().size()
+	vector<Situation> columnSituations(int d_number) const;
+	// replaces erased_length tokens of the input starting at position with the new ones.
+	// Columns up to the position are kept, the following ones are rebuilt until one of
+	// them matches the old chart again, the rest is taken from the old chart.
+	// Returns isViablePrefix()
+	bool edit(size_t position, size_t erased_length, const vector<int>& tokens);
+	bool edit(size_t position, size_t erased_length, const string& text);
+	// all derivations of the input fed so far, see ParseForest
+	ParseForest parseForest() const;
+
 	void print(int d_number);
+	void print(ostream& os, const Situation& situation) const;
 
+	friend void testPrintingSituations();
 	friend void testPredict();
 	friend void testComplete();
 	friend void testScan();
+	friend void testPredictionClosure();
 	friend void testSituationsUpdating();
+	friend void testScanIndex();
+	friend void testLeoRightRecursion();
+	friend void testTokenRecognition();
+	friend void testEditing();
 };
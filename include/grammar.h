@@ -4,38 +4,56 @@
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <unordered_set>
 
 using std::string;
 using std::vector;
 using std::istream;
 using std::ostream;
 using std::runtime_error;
+using std::unordered_set;
 
 struct Rule {
     string from;
     vector<string> to; // symbols are separated with spaces
-    // alphabet symbols - lower case English symbols
+    // alphabet symbols - lower case English symbols, brackets and tokens in
+    // double quotes, such as "while" or "+="
 };
 
 bool isAlphabetSymbol(const string& symbol);
+// the text the alphabet symbol matches in the input: a token without its quotes
+string terminalText(const string& symbol);
 bool operator == (const Rule& rule1, const Rule& rule2);
 
+struct RuleHash {
+    size_t operator () (const Rule& rule) const;
+};
+
 istream& operator >> (istream& is, Rule& rule);
 template<typename T>
 ostream& operator << (ostream& os, const vector<T>& v);
 ostream& operator << (ostream& os, const Rule& rule);
 
+// symbols and rules keep the order they were added in; both are also hashed,
+// so membership checks don't depend on the size of the grammar.
+// Change them only through the methods, or the hashes get out of date
 class Grammar {
 public:
     void setStartingSymbol(const string& starting_symbol);
     void addSymbol(const string& symbol);
     void addRule(const Rule& rule);
+    // linear: the following rules are shifted to keep the order
     void removeRule(const Rule& rule);
     bool containsRule(const Rule& rule) const;
+    bool containsSymbol(const string& symbol) const;
 
     string starting_symbol;
     vector<string> symbols;
     vector<Rule> rules;
+
+private:
+    unordered_set<string> symbol_set_;
+    unordered_set<Rule, RuleHash> rule_set_;
 };
 
 bool operator == (const Grammar&, const Grammar&);
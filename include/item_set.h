@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::vector;
+
+// mixes all bits of the key (splitmix64 finalizer)
+uint64_t mixKey(uint64_t key);
+
+// open addressing hash set of 64-bit keys which remembers insertion order:
+// the keys themselves are stored densely, the table only holds their positions
+class ItemSet {
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	// returns position of the key and whether it was inserted
+	pair<uint32_t, bool> insert(uint64_t key);
+	// returns npos if the key is absent
+	uint32_t find(uint64_t key) const;
+	bool contains(uint64_t key) const;
+
+	uint64_t operator [] (uint32_t position) const {
+		return keys_[position];
+	}
+	uint32_t size() const {
+		return keys_.size();
+	}
+	// keeps the memory, so a cleared set can be refilled without allocations
+	void clear();
+	// removes the keys inserted after the first size ones
+	void truncate(uint32_t size);
+
+private:
+	void grow_();
+
+	vector<uint64_t> keys_;
+	vector<uint32_t> slots_; // position of the key + 1, 0 for an empty slot
+};
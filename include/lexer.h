@@ -0,0 +1,42 @@
+#pragma once
+
+#include "compiled_grammar.h"
+
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// splits the input into tokens and maps them to terminal ids of the grammar.
+// Text which is no terminal of the grammar becomes -1, which is never scanned,
+// so such an input just isn't recognized
+class Lexer {
+public:
+	virtual ~Lexer() = default;
+	// replaces the contents of tokens with the terminal ids of the text
+	virtual void tokenize(const CompiledGrammar& grammar, const string& text,
+			vector<int>& tokens) const = 0;
+};
+
+// every character is a token, the way strings are recognized without a lexer
+class CharacterLexer : public Lexer {
+public:
+	void tokenize(const CompiledGrammar& grammar, const string& text,
+			vector<int>& tokens) const override;
+};
+
+// tokens are separated with whitespace
+class WhitespaceLexer : public Lexer {
+public:
+	void tokenize(const CompiledGrammar& grammar, const string& text,
+			vector<int>& tokens) const override;
+};
+
+// whitespace is skipped, otherwise the longest terminal text at the current position
+// is the next token; a character no terminal starts with is a token of its own
+class LongestMatchLexer : public Lexer {
+public:
+	void tokenize(const CompiledGrammar& grammar, const string& text,
+			vector<int>& tokens) const override;
+};
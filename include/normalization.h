@@ -0,0 +1,49 @@
+#pragma once
+
+#include "grammar.h"
+
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using std::ostream;
+using std::pair;
+using std::string;
+using std::unordered_set;
+using std::vector;
+
+// passes of the conversion to Chomsky normal form, each of them returns an
+// equivalent grammar; epsilon rules are written as A--->epsilon
+
+struct GrammarSize {
+	size_t rules_number;
+	size_t nonterminals_number;
+	size_t length; // the number of symbols in all rules, left sides included
+};
+
+GrammarSize grammarSize(const Grammar& grammar);
+ostream& operator << (ostream& os, const GrammarSize& size);
+
+// nonterminals deriving epsilon, in time linear in the size of the grammar
+unordered_set<string> findNullableSymbols(const Grammar& grammar);
+// removes the unproductive symbols, then the unreachable ones, with their rules
+Grammar removeUselessSymbols(const Grammar& grammar);
+// right sides longer than two symbols are split into chains of new nonterminals,
+// terminals in right sides of two symbols are replaced with new nonterminals
+Grammar binarize(const Grammar& grammar);
+// the only epsilon rule left is S--->epsilon, and then S is in no right side,
+// a new starting symbol is added for that if needed. The number of rules made
+// of a rule is exponential in its nullable symbols, so binarize first
+Grammar removeEpsilonRules(const Grammar& grammar);
+// every A--->B is replaced with A--->alpha for the rules B--->alpha which aren't
+// unit rules; the grammar can grow quadratically. A nonterminal which is in one
+// right side P--->X A only gives P--->X B instead, and the nonterminals which
+// become unreachable from the start get no rules
+Grammar removeUnitRules(const Grammar& grammar);
+
+// all of the passes in order: every rule is A--->a, A--->B C or S--->epsilon,
+// as chomskyToGreybuh expects. pass_sizes gets the size of the input and the
+// size after every pass, with the names of the passes
+Grammar toChomskyForm(const Grammar& grammar, vector<pair<string, GrammarSize>>* pass_sizes = nullptr);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "compiled_grammar.h"
+#include "chart.h"
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// shared packed parse forest of all derivations of an input, binarized. A node is a
+// symbol with the span of tokens [begin, end) it derives, or an intermediate node:
+// an item A--->X1 ... Xk . beta with k >= 2 and the span X1 ... Xk derive.
+// The packed nodes of a node are its alternative derivations, each of them moves
+// the dot over one symbol X: right is the node of X, which starts at the pivot,
+// and left is the node of the symbols before X, none if there are no such symbols.
+// Nodes with the same label and span are shared, so a forest of n tokens takes
+// O(n^3) space however many trees it has; grammars with cycles give cyclic forests
+class ParseForest {
+public:
+	static constexpr int none = -1;
+
+	struct Node {
+		int symbol; // none for intermediate nodes
+		uint32_t item; // intermediate nodes only
+		uint32_t begin;
+		uint32_t end;
+		// packed nodes of the node are [packed_begin, packed_end), terminals have none
+		uint32_t packed_begin;
+		uint32_t packed_end;
+	};
+	struct PackedNode {
+		uint32_t item; // the dot is after the symbol of right
+		uint32_t pivot;
+		int left;
+		int right; // none only for empty rules
+	};
+
+	// the chart has to hold the links of all situations
+	ParseForest(const CompiledGrammar& grammar, const Chart& chart);
+
+	// the starting symbol over the whole input, none if the input isn't recognized
+	int root() const {
+		return root_;
+	}
+	int nodesNumber() const {
+		return nodes_.size();
+	}
+	const Node& node(int node_number) const {
+		return nodes_[node_number];
+	}
+	int packedNodesNumber() const {
+		return packed_nodes_.size();
+	}
+	const PackedNode& packedNode(int packed_node_number) const {
+		return packed_nodes_[packed_node_number];
+	}
+
+private:
+	class Builder;
+
+	vector<Node> nodes_;
+	vector<PackedNode> packed_nodes_;
+	int root_ = none;
+};
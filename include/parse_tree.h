@@ -0,0 +1,109 @@
+#pragma once
+
+#include "compiled_grammar.h"
+#include "parse_forest.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+using std::ostream;
+using std::vector;
+
+// a derivation tree: node 0 is the root and the children of a node are the symbols
+// of its rule in order, so a node of an empty rule has no children
+class ParseTree {
+public:
+	struct Node {
+		int symbol;
+		int rule; // -1 for terminals
+		uint32_t begin;
+		uint32_t end;
+		// children are child(i) for i in [children_begin, children_end)
+		uint32_t children_begin;
+		uint32_t children_end;
+	};
+
+	int nodesNumber() const {
+		return nodes_.size();
+	}
+	const Node& node(int node_number) const {
+		return nodes_[node_number];
+	}
+	int child(uint32_t i) const {
+		return children_[i];
+	}
+
+	// sum of the costs of the rules of the tree, rule_costs is indexed by rule number
+	double cost(const vector<double>& rule_costs) const;
+	// S(a S(b)): every nonterminal is followed by its children in brackets
+	void print(ostream& os, const CompiledGrammar& grammar) const;
+
+	// nodes are added in preorder, a parent before its children
+	void clear();
+	void addNode(int symbol, int rule, uint32_t begin, uint32_t end, int parent);
+	// links the children once all nodes are added
+	void finish();
+
+private:
+	vector<Node> nodes_;
+	vector<int> parents_;
+	vector<int> children_;
+};
+
+// the number of trees in the forest, saturated at many_trees; cyclic forests
+// have infinitely many trees, so many_trees too
+constexpr uint64_t many_trees = UINT64_MAX;
+uint64_t countTrees(const ParseForest& forest);
+
+// lists the trees of a forest one by one, in memory linear in the size of a tree
+// and the forest. Trees in which a forest node derives itself are skipped, so a
+// cyclic forest gives only finitely many of its trees
+class TreeEnumerator {
+public:
+	// both have to outlive the enumerator
+	TreeEnumerator(const CompiledGrammar& grammar, const ParseForest& forest);
+	// the first call gives the first tree; false when there are no more trees
+	bool next(ParseTree& tree);
+
+private:
+	// a forest node of the current tree with the packed node chosen for it
+	struct Step {
+		int node;
+		uint32_t packed; // npos for terminals
+		int parent;
+		bool is_left; // whether the node is the left child of the parent's packed node
+	};
+	struct Pending {
+		int node;
+		int parent;
+		bool is_left;
+	};
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	// whether the children of the packed node are no ancestors of the step's node
+	bool isAcyclic_(int step_number, uint32_t packed) const;
+	// the first acyclic alternative of the step starting from packed, or npos
+	uint32_t nextAlternative_(int step_number, uint32_t packed) const;
+	void pushChildren_(int step_number);
+	// expands the pending nodes, false at a node without acyclic alternatives
+	bool expand_();
+	// moves to the next alternative of the last step which has one
+	bool backtrack_();
+	void buildTree_(ParseTree& tree);
+
+	const CompiledGrammar& grammar_;
+	const ParseForest& forest_;
+	vector<int> components_; // strongly connected components of the forest
+	vector<bool> cyclic_components_;
+	vector<Step> steps_; // the current tree in preorder
+	vector<Pending> pending_;
+	vector<int> tree_nodes_; // by step, scratch of buildTree_
+	bool started_ = false;
+};
+
+// up to k trees of the least costs in the order of costs, see ParseTree::cost.
+// Throws runtime_error for cyclic forests, whose best trees are not defined
+// when costs may be zero, and for too few rule costs
+vector<ParseTree> bestTrees(const CompiledGrammar& grammar, const ParseForest& forest,
+		const vector<double>& rule_costs, int k);
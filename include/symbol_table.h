@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using std::string;
+using std::vector;
+using std::unordered_map;
+
+class SymbolTable {
+public:
+	// returns id of the symbol, registering it if it is met for the first time
+	int intern(const string& symbol);
+	// returns -1 if the symbol is unknown
+	int find(const string& symbol) const;
+
+	const string& name(int id) const;
+	bool isTerminal(int id) const;
+	int size() const;
+
+private:
+	unordered_map<string, int> ids_;
+	vector<string> names_;
+	vector<bool> is_terminal_;
+};
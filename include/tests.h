@@ -2,12 +2,26 @@
 
 #include "grammar.h"
 #include "chomsky_to_greybuh.h"
+#include "normalization.h"
 #include "test_runner.h"
 #include "earley.h"
+#include "symbol_table.h"
+#include "item_set.h"
+#include "chart.h"
+#include "batch.h"
+#include "lexer.h"
+#include "parse_tree.h"
+#include "cyk.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <set>
+#include <sstream>
 
 using std::cout;
+using std::istringstream;
 using std::endl;
 
 void testIsAlphabetSymbol() {
@@ -15,6 +29,33 @@ void testIsAlphabetSymbol() {
 	Assert(isAlphabetSymbol("a"), "a is alphabet symbol");
 	Assert(!isAlphabetSymbol("S"), "S is usually a starting symbol, not alphabet");
 	Assert(!isAlphabetSymbol("epsilon"), "epsilon is not alphabet");
+	Assert(isAlphabetSymbol("\"while\""), "quoted tokens are alphabet symbols");
+	Assert(!isAlphabetSymbol("\"\""), "a token is not empty");
+	AssertEqual(terminalText("\"while\""), "while");
+	AssertEqual(terminalText("("), "(");
+}
+
+void testGrammarIndexes() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"A", "b"}});
+	grammar.addRule({"A", {"a"}});
+	grammar.addRule({"S", {"A", "b"}});
+	AssertEqual(grammar.rules.size(), 2u, "rules are added once");
+	AssertEqual(grammar.symbols.size(), 2u, "S and A, alphabet symbols are not stored");
+	Assert(grammar.containsSymbol("A"), "A is a symbol");
+	Assert(!grammar.containsSymbol("b"), "b is an alphabet symbol");
+	Assert(grammar.containsRule({"A", {"a"}}), "A--->a is a rule");
+	Assert(!grammar.containsRule({"A", {"b"}}), "A--->b is not a rule");
+
+	Grammar copy = grammar;
+	copy.removeRule({"S", {"A", "b"}});
+	Assert(!copy.containsRule({"S", {"A", "b"}}), "the rule is removed");
+	Assert(grammar.containsRule({"S", {"A", "b"}}), "the copy has its own rules");
+	Assert(!(copy == grammar), "grammars with different rules differ");
+	copy.addRule({"S", {"A", "b"}});
+	Assert(copy == grammar, "the order of rules doesn't matter");
+	AssertEqual(copy.rules.back(), Rule({"S", {"A", "b"}}), "a rule added again goes last");
 }
 
 void testRemoveEpsilon() {
@@ -74,77 +115,528 @@ void testChomskyToGreybuh() {
 	vector<Rule> expected_rules = {
 		{"S", {"epsilon"}},
 		{"S", {"a", "A\\S"}},
-		{"S", {"b", "B\\S"}},
-		{"A\\A", {"a", "A\\B", "S\\A"}},
-		{"A\\B", {"a", "A\\B", "S\\B"}},
-		{"A\\S", {"a", "A\\B", "S\\S"}},
-		{"A\\A", {"b", "B\\B", "S\\A"}},
-		{"A\\B", {"b", "B\\B", "S\\B"}},
-		{"A\\S", {"b", "B\\B", "S\\S"}},
-		{"A\\S", {"a", "A\\B"}},
-		{"A\\A", {"b", "S\\A"}},
-		{"A\\B", {"b", "S\\B"}},
 		{"A\\S", {"b"}},
-		{"A\\S", {"b", "B\\B"}},
-		{"A\\S", {"b", "S\\S"}},
 	};
 	for (unsigned i = 0; i < expected_rules.size(); ++i) {
 		expected_grammar.addRule(expected_rules[i]);
 	}
 	AssertEqual(chomskyToGreybuh(grammar), expected_grammar);
+
+	// balanced brackets: S'--->epsilon | L B | S S | L R, S--->L B | S S | L R, B--->S R
+	Grammar brackets;
+	brackets.setStartingSymbol("S'");
+	rules = {
+		{"S'", {"epsilon"}},
+		{"S'", {"L", "B"}},
+		{"S'", {"S", "S"}},
+		{"S'", {"L", "R"}},
+		{"S", {"L", "B"}},
+		{"S", {"S", "S"}},
+		{"S", {"L", "R"}},
+		{"B", {"S", "R"}},
+		{"L", {"("}},
+		{"R", {")"}},
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		brackets.addRule(rules[i]);
+	}
+	Grammar greibach_brackets = chomskyToGreybuh(brackets);
+	for (const Rule& rule : greibach_brackets.rules) {
+		Assert(isAlphabetSymbol(rule.to[0]) || rule.from == "S'", "rules start with terminals");
+	}
+	EarleyAlgorithm earley_algorithm;
+	const string alphabet = "()";
+	for (int mask = 0; mask < (1 << 10); ++mask) {
+		string s;
+		for (int i = 0; i < mask % 11; ++i) {
+			s += alphabet[(mask >> i) & 1];
+		}
+		AssertEqual(earley_algorithm.isRecognized(greibach_brackets, s),
+				earley_algorithm.isRecognized(brackets, s), s);
+	}
+
+	// a chain of 100 left children gives levels big enough to be split between threads
+	Grammar chain;
+	chain.setStartingSymbol("S");
+	chain.addRule({"S", {"N0", "N0"}});
+	for (int i = 0; i < 100; ++i) {
+		chain.addRule({"N" + std::to_string(i), {"N" + std::to_string(i + 1), "A"}});
+	}
+	chain.addRule({"N100", {"a"}});
+	chain.addRule({"A", {"a"}});
+	Grammar greibach_chain = chomskyToGreybuh(chain);
+	AssertEqual(chomskyToGreybuh(chain, 4), greibach_chain, "threads don't change the result");
+	Assert(earley_algorithm.isRecognized(greibach_chain, string(202, 'a')), "S derives a^202");
+	Assert(!earley_algorithm.isRecognized(greibach_chain, string(201, 'a')), "and nothing else");
+}
+
+Grammar makeGrammar(const string& starting_symbol, const vector<Rule>& rules) {
+	Grammar grammar;
+	grammar.setStartingSymbol(starting_symbol);
+	for (const Rule& rule : rules) {
+		grammar.addRule(rule);
+	}
+	return grammar;
+}
+
+void testNormalization() {
+	Grammar nullable = makeGrammar("S", {
+		{"S", {"A", "B"}},
+		{"A", {"epsilon"}},
+		{"B", {"A", "A"}},
+		{"B", {"b"}},
+		{"C", {"c", "A"}},
+	});
+	Assert(findNullableSymbols(nullable) == unordered_set<string>({"S", "A", "B"}), "S, A and B are nullable");
+
+	// C is unproductive, D is unreachable
+	Grammar useless = makeGrammar("S", {
+		{"S", {"a", "A"}},
+		{"S", {"C", "A"}},
+		{"A", {"a"}},
+		{"C", {"c", "C"}},
+		{"D", {"d"}},
+	});
+	AssertEqual(removeUselessSymbols(useless), makeGrammar("S", {{"S", {"a", "A"}}, {"A", {"a"}}}));
+	AssertEqual(removeUselessSymbols(makeGrammar("S", {{"S", {"S"}}})).rules.size(), 0u,
+			"nothing is derived from S");
+
+	Grammar long_rule = makeGrammar("S", {{"S", {"a", "B", "c", "B"}}, {"B", {"b"}}});
+	AssertEqual(binarize(long_rule), makeGrammar("S", {
+		{"T_1", {"a"}},
+		{"T_2", {"c"}},
+		{"S", {"T_1", "S_3"}},
+		{"S_3", {"B", "S_4"}},
+		{"S_4", {"T_2", "B"}},
+		{"B", {"b"}},
+	}));
+
+	// S' is in no right side, so it keeps its epsilon rule
+	Grammar epsilon = makeGrammar("S'", {
+		{"S'", {"epsilon"}},
+		{"S'", {"b", "S"}},
+		{"S", {"a", "A", "A"}},
+		{"A", {"a"}},
+		{"A", {"epsilon"}},
+	});
+	AssertEqual(removeEpsilonRules(epsilon), makeGrammar("S'", {
+		{"S'", {"epsilon"}},
+		{"S'", {"b", "S"}},
+		{"S", {"a"}},
+		{"S", {"a", "A"}},
+		{"S", {"a", "A", "A"}},
+		{"A", {"a"}},
+	}));
+	// S is, so a new starting symbol derives epsilon
+	Grammar nullable_start = makeGrammar("S", {{"S", {"a", "S"}}, {"S", {"epsilon"}}});
+	AssertEqual(removeEpsilonRules(nullable_start), makeGrammar("S_1", {
+		{"S_1", {"S"}},
+		{"S_1", {"epsilon"}},
+		{"S", {"a", "S"}},
+		{"S", {"a"}},
+	}));
+
+	Grammar units = makeGrammar("S", {
+		{"S", {"A"}},
+		{"S", {"b"}},
+		{"A", {"B"}},
+		{"A", {"a"}},
+		{"B", {"A"}},
+		{"B", {"c", "c"}},
+	});
+	AssertEqual(removeUnitRules(units), makeGrammar("S", {
+		{"S", {"b"}},
+		{"S", {"a"}},
+		{"S", {"c", "c"}},
+	}));
+
+	// the chain ends are unreachable without the unit rules and don't get rules
+	vector<Rule> chain_rules = {{"S", {"A_1"}}};
+	for (int i = 1; i < 10; ++i) {
+		chain_rules.push_back({"A_" + std::to_string(i), {"A_" + std::to_string(i + 1)}});
+	}
+	chain_rules.push_back({"A_10", {"a"}});
+	chain_rules.push_back({"A_10", {"b", "c"}});
+	Grammar chain = makeGrammar("S", chain_rules);
+	AssertEqual(removeUnitRules(chain).rules.size(), 2u);
+	AssertEqual(removeUnitRules(chain), makeGrammar("S", {{"S", {"a"}}, {"S", {"b", "c"}}}));
+
+	// H is in one right side, its unit rule goes there instead of copying the rules of B
+	Grammar used_once = makeGrammar("S", {
+		{"S", {"a", "H"}},
+		{"H", {"b", "b"}},
+		{"H", {"B"}},
+		{"B", {"c"}},
+		{"B", {"d", "d"}},
+	});
+	AssertEqual(removeUnitRules(used_once), makeGrammar("S", {
+		{"S", {"a", "H"}},
+		{"S", {"a", "B"}},
+		{"H", {"b", "b"}},
+		{"B", {"c"}},
+		{"B", {"d", "d"}},
+	}));
+
+	// balanced brackets in Chomsky form and then in Greibach form
+	Grammar brackets = makeGrammar("S", {{"S", {"(", "S", ")", "S"}}, {"S", {"epsilon"}}});
+	vector<pair<string, GrammarSize>> pass_sizes;
+	Grammar chomsky_brackets = toChomskyForm(brackets, &pass_sizes);
+	AssertEqual(pass_sizes.size(), 6u);
+	AssertEqual(pass_sizes[0].first, "input");
+	AssertEqual(pass_sizes[0].second.rules_number, 2u);
+	AssertEqual(pass_sizes[0].second.length, 6u);
+	AssertEqual(pass_sizes.back().second.rules_number, chomsky_brackets.rules.size());
+	for (const Rule& rule : chomsky_brackets.rules) {
+		classifyRuleChomskyToGreybuh(rule, chomsky_brackets.starting_symbol);
+	}
+	Grammar greibach_brackets = chomskyToGreybuh(chomsky_brackets);
+	EarleyAlgorithm earley_algorithm;
+	const string alphabet = "()";
+	for (int mask = 0; mask < (1 << 10); ++mask) {
+		string s;
+		for (int i = 0; i < mask % 11; ++i) {
+			s += alphabet[(mask >> i) & 1];
+		}
+		bool is_recognized = earley_algorithm.isRecognized(brackets, s);
+		AssertEqual(earley_algorithm.isRecognized(chomsky_brackets, s), is_recognized, s);
+		AssertEqual(earley_algorithm.isRecognized(greibach_brackets, s), is_recognized, s);
+	}
+}
+
+void testSymbolTable() {
+	SymbolTable symbols;
+	int s_id = symbols.intern("S");
+	int a_id = symbols.intern("a");
+	AssertEqual(symbols.intern("S"), s_id, "interning is idempotent");
+	AssertEqual(symbols.find("a"), a_id);
+	AssertEqual(symbols.find("B"), -1);
+	AssertEqual(symbols.size(), 2);
+	AssertEqual(symbols.name(s_id), "S");
+	Assert(symbols.isTerminal(a_id), "a is terminal");
+	Assert(!symbols.isTerminal(s_id), "S is not terminal");
 }
 
 void testSituationsOperatorEqual() {
-	Rule rule = {"A", {"B", "a"}};
-	Situation situation({rule, 0, 1});
+	Situation situation{1, 0};
 	Assert(situation == situation, "reflexivity test failed for situations ==");
-	Assert(!(situation == Situation{rule, 0, 2}),
-			"different positions - different situations");
+	Assert(!(situation == Situation{2, 0}),
+			"different items - different situations");
+	Assert(!(situation == Situation{1, 1}),
+			"different origins - different situations");
 }
 
 void testPrintingSituations() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	grammar.addRule({"A", {"B", "a"}});
+
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(grammar);
+	earley_algorithm.initialize_(compiled_grammar);
 	ostringstream os;
-	Rule rule = {"A", {"B", "a"}};
-	Situation situation({rule, 0, 1});
-	os << situation;
+	earley_algorithm.print(os, earley_algorithm.scan_(earley_algorithm.predict_(0, 0)));
 	AssertEqual(os.str(), "A--->B a 0 1");
 }
 
-void testSituationHash() {
-	Rule rule = {"S", {"(", ")"}};
-	Situation situation({rule, 0, 1});
-	size_t hash0 = SituationHash()(situation);
-	AssertEqual(hash0, SituationHash()(situation)); // hash should be the same
-	situation.deduced_prefix_length = 1;
-	Assert(hash0 != SituationHash()(situation),
-			"situation change should change after changing it's fields");
+void testCompiledGrammar() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	vector<Rule> rules = {
+		{"S", {"S'", "a"}},
+		{"S'", {"epsilon"}},
+		{"S'", {"b"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+	CompiledGrammar compiled_grammar(grammar);
+	const SymbolTable& symbols = compiled_grammar.symbols();
+	AssertEqual(compiled_grammar.rulesNumber(), 4);
+	int start_rule = compiled_grammar.startRule();
+	AssertEqual(symbols.name(compiled_grammar.ruleFrom(start_rule)), "S''",
+			"start rule should use a new symbol");
+	AssertEqual(compiled_grammar.ruleSymbol(start_rule, 0), symbols.find("S"));
+	AssertEqual(compiled_grammar.ruleLength(1), 0, "epsilon is dropped from rules");
+	Assert(compiled_grammar.isNullable(symbols.find("S'")), "S' is nullable");
+	AssertEqual(compiled_grammar.characterSymbol('b'), symbols.find("b"));
+	AssertEqual(compiled_grammar.characterSymbol('c'), -1);
+	Assert(compiled_grammar.isProductive(symbols.find("S")), "S is productive");
+
+	// the same compiled grammar serves several recognitions
+	EarleyAlgorithm earley_algorithm;
+	Assert(earley_algorithm.isRecognized(compiled_grammar, "a"), "a is recognized");
+	Assert(earley_algorithm.isRecognized(compiled_grammar, "ba"), "ba is recognized");
+	Assert(!earley_algorithm.isRecognized(compiled_grammar, "bba"), "bba is not recognized");
+	Assert(!EarleyAlgorithm().isRecognized(compiled_grammar, "b"), "b is not recognized");
+}
+
+void testCompiledGrammarFile() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"(", "S", ")", "S"}});
+	grammar.addRule({"S", {"\"while\"", "A"}});
+	grammar.addRule({"S", {}});
+	grammar.addRule({"A", {"a", "A"}});
+	CompiledGrammar compiled_grammar(grammar);
+	const string file_name = "test_compiled_grammar.bin";
+	compiled_grammar.save(file_name);
+	CompiledGrammar loaded_grammar = CompiledGrammar::load(file_name);
+
+	const SymbolTable& symbols = compiled_grammar.symbols();
+	AssertEqual(loaded_grammar.symbols().size(), symbols.size());
+	for (int symbol = 0; symbol < symbols.size(); ++symbol) {
+		AssertEqual(loaded_grammar.symbols().name(symbol), symbols.name(symbol));
+		AssertEqual(loaded_grammar.isTerminal(symbol), compiled_grammar.isTerminal(symbol));
+		AssertEqual(loaded_grammar.isNullable(symbol), compiled_grammar.isNullable(symbol));
+		AssertEqual(loaded_grammar.isProductive(symbol), compiled_grammar.isProductive(symbol));
+		if (!symbols.isTerminal(symbol)) {
+			Assert(vector<uint32_t>(loaded_grammar.predictionBegin(symbol),
+					loaded_grammar.predictionEnd(symbol)) ==
+					vector<uint32_t>(compiled_grammar.predictionBegin(symbol),
+					compiled_grammar.predictionEnd(symbol)), symbols.name(symbol) + " predictions");
+		}
+	}
+	AssertEqual(loaded_grammar.rulesNumber(), compiled_grammar.rulesNumber());
+	AssertEqual(loaded_grammar.startRule(), compiled_grammar.startRule());
+	for (int rule_number = 0; rule_number < compiled_grammar.rulesNumber(); ++rule_number) {
+		AssertEqual(loaded_grammar.ruleFrom(rule_number), compiled_grammar.ruleFrom(rule_number));
+		AssertEqual(loaded_grammar.ruleLength(rule_number), compiled_grammar.ruleLength(rule_number));
+		AssertEqual(loaded_grammar.ruleFirstItem(rule_number),
+				compiled_grammar.ruleFirstItem(rule_number));
+	}
+	AssertEqual(loaded_grammar.terminalSymbol("while"), compiled_grammar.terminalSymbol("while"));
+	AssertEqual(loaded_grammar.characterSymbol('('), compiled_grammar.characterSymbol('('));
+	EarleyAlgorithm earley_algorithm;
+	Assert(earley_algorithm.isRecognized(loaded_grammar, "(()())"), "(()()) is recognized");
+	Assert(!earley_algorithm.isRecognized(loaded_grammar, "(()"), "(() is not recognized");
+
+	// the first item of the first rule is said to be an item of the last rule: every index
+	// is still in its table, but the position of the item in its rule would be negative.
+	// The tables follow the magic and the header, each of them padded to 4 bytes
+	auto padded = [](size_t bytes_number) {
+		return (bytes_number + 3) / 4 * 4;
+	};
+	size_t names_length = 0;
+	for (int symbol = 0; symbol < symbols.size(); ++symbol) {
+		names_length += symbols.name(symbol).size();
+	}
+	size_t rule_symbols_number = 0;
+	for (int rule_number = 0; rule_number < compiled_grammar.rulesNumber(); ++rule_number) {
+		rule_symbols_number += compiled_grammar.ruleLength(rule_number);
+	}
+	size_t item_rule_offset = 8 + 9 * sizeof(uint32_t) + sizeof(uint32_t) * symbols.size() +
+			padded(names_length) + sizeof(int) * (3 * compiled_grammar.rulesNumber() + 1) +
+			sizeof(int) * rule_symbols_number;
+	int32_t tampered_rule = compiled_grammar.rulesNumber() - 1;
+	Assert(compiled_grammar.ruleFirstItem(tampered_rule) > compiled_grammar.ruleFirstItem(0),
+			"the last rule has later items");
+	std::fstream tampered_file(file_name, std::ios::in | std::ios::out | std::ios::binary);
+	tampered_file.seekg(item_rule_offset + sizeof(int32_t) * compiled_grammar.ruleFirstItem(0));
+	int32_t item_rule = -1;
+	tampered_file.read(reinterpret_cast<char*>(&item_rule), sizeof(item_rule));
+	AssertEqual(item_rule, 0, "the item table is where it is expected");
+	tampered_file.seekp(item_rule_offset + sizeof(int32_t) * compiled_grammar.ruleFirstItem(0));
+	tampered_file.write(reinterpret_cast<const char*>(&tampered_rule), sizeof(tampered_rule));
+	tampered_file.close();
+	bool is_rejected = false;
+	try {
+		CompiledGrammar::load(file_name);
+	} catch (const runtime_error&) {
+		is_rejected = true;
+	}
+	Assert(is_rejected, "an item of another rule's range is rejected");
+
+	// nothing is derived from S, so no symbol is nullable and nothing is predicted:
+	// empty tables are written and read too
+	Grammar unproductive_grammar;
+	unproductive_grammar.setStartingSymbol("S");
+	unproductive_grammar.addRule({"S", {"S", "a"}});
+	CompiledGrammar compiled_unproductive_grammar(unproductive_grammar);
+	compiled_unproductive_grammar.save(file_name);
+	CompiledGrammar loaded_unproductive_grammar = CompiledGrammar::load(file_name);
+	AssertEqual(loaded_unproductive_grammar.rulesNumber(), compiled_unproductive_grammar.rulesNumber());
+	int start = loaded_unproductive_grammar.symbols().find("S");
+	Assert(!loaded_unproductive_grammar.isNullable(start) && !loaded_unproductive_grammar.isProductive(start),
+			"S is neither nullable nor productive");
+	AssertEqual(loaded_unproductive_grammar.predictionEnd(start) - loaded_unproductive_grammar.predictionBegin(start),
+			0, "S--->S a is never completed, so it isn't predicted");
+	Assert(!earley_algorithm.isRecognized(loaded_unproductive_grammar, "a"), "a is not recognized");
+
+	// a file of another version is rejected instead of being misread
+	std::fstream file(file_name, std::ios::in | std::ios::out | std::ios::binary);
+	file.seekp(8);
+	file.put(2);
+	file.close();
+	bool thrown = false;
+	try {
+		CompiledGrammar::load(file_name);
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	Assert(thrown, "version 2 is not supported");
+	std::remove(file_name.c_str());
+	thrown = false;
+	try {
+		CompiledGrammar::load(file_name);
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	Assert(thrown, "a missing file can't be loaded");
+}
+
+void testPackingSituations() {
+	Situation situation{7, 3};
+	AssertEqual(unpackSituation(packSituation(situation)), situation);
+	Assert(packSituation(situation) != packSituation(Situation{3, 7}),
+			"item and origin should not be interchangeable in the key");
+}
+
+void testItemSet() {
+	ItemSet item_set;
+	Assert(!item_set.contains(5), "empty set contains nothing");
+	for (uint64_t key = 0; key < 1000; ++key) {
+		auto insert_result = item_set.insert(key * key);
+		Assert(insert_result.second, "new key should be inserted");
+		AssertEqual(insert_result.first, key, "keys are numbered in insertion order");
+	}
+	AssertEqual(item_set.insert(49).first, 7u);
+	Assert(!item_set.insert(49).second, "repeated key should not be inserted");
+	AssertEqual(item_set.size(), 1000u);
+	AssertEqual(item_set[10], 100u);
+	AssertEqual(item_set.find(50), ItemSet::npos);
+	item_set.clear();
+	AssertEqual(item_set.size(), 0u);
+	Assert(!item_set.contains(49), "set should be empty after clear");
+
+	// a few keys in the big table left by the first fill
+	for (uint64_t key = 0; key < 50; ++key) {
+		item_set.insert(key * 16);
+	}
+	AssertEqual(item_set.find(48), 3u);
+	item_set.clear();
+	for (uint64_t key = 0; key < 50; ++key) {
+		Assert(!item_set.contains(key * 16), "set should be empty after the second clear");
+	}
+	Assert(item_set.insert(7).second, "key should be inserted after the second clear");
+}
+
+void testChartWaitingIndex() {
+	Chart chart;
+	chart.addColumn();
+	Assert(chart.insert({7, 0}, 5), "new situation");
+	chart.addColumn();
+	Assert(chart.insert({0, 0}, 5), "new situation");
+	Assert(chart.insert({1, 0}, -1), "new situation");
+	Assert(chart.insert({2, 1}, 5), "new situation");
+	Assert(chart.insert({3, 0}, 6), "new situation");
+	Assert(!chart.insert({2, 1}, 5), "repeated situation");
+	Assert(chart.insert({7, 0}, 5), "columns are deduplicated separately");
+	AssertEqual(chart.columnsNumber(), 2u);
+	AssertEqual(chart.columnBegin(1), 1u);
+	AssertEqual(chart.columnSize(1), 5u);
+
+	auto waitingPositions = [&chart](int d_number, int symbol) {
+		vector<uint32_t> positions;
+		for (uint32_t k = chart.firstWaiting(d_number, symbol); k != Chart::npos;
+				k = chart.nextWaiting(k)) {
+			positions.push_back(k);
+		}
+		return positions;
+	};
+	Assert(waitingPositions(1, 5) == vector<uint32_t>({1, 3, 5}), "situations waiting for 5");
+	Assert(waitingPositions(0, 5) == vector<uint32_t>({0}), "situations waiting for 5 in column 0");
+	AssertEqual(chart[chart.firstWaiting(1, 6)], Situation({3, 0}));
+	AssertEqual(chart.firstWaiting(1, 7), Chart::npos);
+	chart.setTransitive(1, 6, packSituation({4, 0}));
+	AssertEqual(chart.transitive(1, 5), Chart::unknown_transitive);
+	AssertEqual(chart.transitive(1, 7), Chart::no_transitive);
+
+	// detached columns keep their situations and chains, reattaching shifts origins after 0
+	chart.addColumn();
+	Assert(chart.insert({8, 1}, 5), "new situation");
+	chart.detach(1);
+	AssertEqual(chart.columnsNumber(), 1u);
+	Assert(chart.contains({7, 0}), "column 0 is the last one again");
+	AssertEqual(chart[chart.detachedBegin(1)], Situation({8, 1}));
+	chart.addColumn();
+	Assert(chart.insert({9, 0}, -1), "new situation in a rebuilt column");
+	chart.reattach(1, 0, 2);
+	AssertEqual(chart.columnsNumber(), 3u);
+	Assert(chart.contains({8, 3}), "origin 1 is shifted");
+	AssertEqual(chart[chart.firstWaiting(2, 5)], Situation({8, 3}));
+	AssertEqual(chart.firstWaiting(1, 5), Chart::npos);
+	AssertEqual(chart[chart.columnBegin(1)], Situation({9, 0}));
+	// the dropped column was bigger than the rest, so the buffer was compacted
+	AssertEqual(chart.columnBegin(2), 2u);
+	AssertEqual(chart[chart.firstWaiting(0, 5)], Situation({7, 0}));
+}
+
+Grammar getItemsTestGrammar() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	grammar.addRule({"A", {"B", "a"}}); // items 0, 1, 2
+	grammar.addRule({"B", {"b"}}); // items 3, 4
+	return grammar;
 }
 
 void testPredict() {
-	Rule rule = {"A", {"B", "a"}};
-	int d_number = 0;
-	Situation expected_situation(rule, d_number, 0);
-	AssertEqual(EarleyAlgorithm().predict_(rule, d_number), expected_situation);
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(getItemsTestGrammar());
+	earley_algorithm.initialize_(compiled_grammar);
+	AssertEqual(earley_algorithm.predict_(1, 2), Situation({3, 2}));
 }
 
 void testComplete() {
-	Rule rule = {"A", {"B", "a"}};
-	Situation situation_k(rule, 0, 0);
-	AssertEqual(EarleyAlgorithm().complete_(situation_k), Situation(rule, 0, 1));
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(getItemsTestGrammar());
+	earley_algorithm.initialize_(compiled_grammar);
+	Situation situation_k{0, 0};
+	AssertEqual(earley_algorithm.complete_(situation_k), Situation({1, 0}));
+	AssertEqual(earley_algorithm.nextSymbol_(situation_k), compiled_grammar.symbols().find("B"));
 }
 
 void testScan() {
-	Rule rule = {"A", {"B", "a"}};
-	Situation situation({rule, 0, 1});
-	Situation expected_situation({rule, 0, 2});
-	AssertEqual(EarleyAlgorithm().scan_(situation), expected_situation);
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(getItemsTestGrammar());
+	earley_algorithm.initialize_(compiled_grammar);
+	Situation situation{1, 0};
+	Situation expected_situation{2, 0};
+	AssertEqual(earley_algorithm.scan_(situation), expected_situation);
+	AssertEqual(earley_algorithm.nextSymbol_(expected_situation), -1);
+	AssertEqual(earley_algorithm.positionInRule_(expected_situation), 2);
+}
+
+void testPredictionClosure() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S"); // the start rule S'--->S is added by CompiledGrammar
+	vector<Rule> rules = {
+		{"S", {"A", "S", "b"}},
+		{"S", {"b"}},
+		{"A", {"C"}},
+		{"A", {}},
+		{"C", {"c"}},
+		{"D", {"d"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(grammar);
+	earley_algorithm.initialize_(compiled_grammar);
+	Assert(compiled_grammar.isNullable(compiled_grammar.symbols().find("A")), "A is nullable");
+	Assert(!compiled_grammar.isNullable(compiled_grammar.symbols().find("S")), "S is not nullable");
+	Assert(!compiled_grammar.isNullable(compiled_grammar.symbols().find("C")), "C is not nullable");
+
+	// one call predicts S, A and C rules, D is not reachable
+	earley_algorithm.predict_(0, earley_algorithm.D_situations_.columnBegin(0));
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(0)), 6);
 }
 
 void testSituationsUpdating() {
 	Grammar grammar;
-	grammar.setStartingSymbol("S'");
+	grammar.setStartingSymbol("S"); // the start rule S'--->S is added by CompiledGrammar
 	vector<Rule> rules = {
-		{"S'", {"S"}},
 		{"S", {}},
 		{"S", {"(", "S", ")", "S"}}
 	};
@@ -154,22 +646,89 @@ void testSituationsUpdating() {
 	string correct_brackets_sequence = "(())()";
 
 	EarleyAlgorithm earley_algorithm;
-	earley_algorithm.initialize_(grammar, correct_brackets_sequence);
-	AssertEqual(static_cast<int>(earley_algorithm.D_situations_[0].size()), 1); // we inserted basic situation
+	CompiledGrammar compiled_grammar(grammar);
+	earley_algorithm.initialize_(compiled_grammar);
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(0)), 1); // we inserted basic situation
 
-	earley_algorithm.predict_(0, grammar, correct_brackets_sequence);
-	AssertEqual(static_cast<int>(earley_algorithm.D_situations_[0].size()), 3);
-	// (S'-->.S,0), (S-->.,0), (S-->.(S)S,0)
+	earley_algorithm.predict_(0, earley_algorithm.D_situations_.columnBegin(0));
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(0)), 4);
+	// (S'-->.S,0), (S'-->S.,0) since S is nullable, (S-->.(S)S,0), (S-->.,0)
 
-	earley_algorithm.complete_(0, correct_brackets_sequence);
-	AssertEqual(static_cast<int>(earley_algorithm.D_situations_[0].size()), 4);
-	// (S'-->.S,0), (S-->.,0), (S-->.(S)S,0), (S'-->S,0)
+	earley_algorithm.processColumn_(0);
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(0)), 4);
+	// nothing new: the empty completion of S has already been taken into account
+
+	earley_algorithm.scan_(0, compiled_grammar.characterSymbol(correct_brackets_sequence[0]));
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(1)), 1);
+
+	earley_algorithm.finalize_();
+	AssertEqual(earley_algorithm.D_situations_.columnsNumber(), 0u);
+
+	// the columns are reused by the next recognition
+	earley_algorithm.initialize_(compiled_grammar);
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(0)), 1);
+	AssertEqual(earley_algorithm.D_situations_.columnsNumber(), 1u);
+}
+
+void testScanIndex() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	vector<Rule> rules = {
+		{"S'", {"S"}},
+		{"S", {"a", "b"}},
+		{"S", {"a", "S"}},
+		{"S", {"b"}},
+		{"S", {"c", "a"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+	string s = "ab";
+
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(grammar);
+	earley_algorithm.initialize_(compiled_grammar);
+	earley_algorithm.processColumn_(0);
+	earley_algorithm.scan_(0, compiled_grammar.characterSymbol(s[0]));
+	// only (S-->a.b, 0) and (S-->a.S, 0)
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(1)), 2);
+	earley_algorithm.processColumn_(1);
+	earley_algorithm.scan_(1, compiled_grammar.characterSymbol(s[1]));
+	// (S-->ab., 0) and (S-->b., 1)
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(2)), 2);
+	earley_algorithm.finalize_();
+}
 
-	earley_algorithm.scan_(0, correct_brackets_sequence);
-	AssertEqual(static_cast<int>(earley_algorithm.D_situations_[1].size()), 1);
+void testLeoRightRecursion() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	vector<Rule> rules = {
+		{"S'", {"S"}},
+		{"S", {"a", "S"}},
+		{"S", {"a"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+	string s(50, 'a');
 
+	EarleyAlgorithm earley_algorithm;
+	CompiledGrammar compiled_grammar(grammar);
+	earley_algorithm.initialize_(compiled_grammar);
+	earley_algorithm.processColumn_(0);
+	for (unsigned i = 1; i <= s.size(); ++i) {
+		earley_algorithm.scan_(i - 1, compiled_grammar.characterSymbol(s[i - 1]));
+		earley_algorithm.processColumn_(i);
+	}
+	// (S-->a.S), (S-->a.), (S-->.aS), (S-->.a) and the topmost completed situation
+	// (S'-->S.) instead of a completed S-->aS. for every position
+	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.columnSize(s.size())), 5);
+	Assert(earley_algorithm.D_situations_.contains(
+			earley_algorithm.scan_(earley_algorithm.predict_(compiled_grammar.startRule(), 0))),
+			"(S'-->S., 0) should be in the last column");
 	earley_algorithm.finalize_();
-	AssertEqual(static_cast<int>(earley_algorithm.D_situations_.size()), 0); // we inserted basic situation
+
+	Assert(earley_algorithm.isRecognized(grammar, s), "a^50 is recognized");
 }
 
 void testIsRecognized() {
@@ -191,18 +750,657 @@ void testIsRecognized() {
 				"incorrect bracket sequence test failed");
 }
 
+void testNullableCompletedBeforeWaiting() {
+	// B is completed empty before A--->B . B starts waiting for it
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	vector<Rule> rules = {
+		{"S'", {"S"}},
+		{"S", {"B", "A"}},
+		{"A", {"B", "B", "a"}},
+		{"B", {}},
+		{"B", {"b"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+	Assert(EarleyAlgorithm().isRecognized(grammar, "a"), "a is recognized");
+	Assert(EarleyAlgorithm().isRecognized(grammar, "bba"), "bba is recognized");
+	Assert(EarleyAlgorithm().isRecognized(grammar, "bbba"), "bbba is recognized");
+	Assert(!EarleyAlgorithm().isRecognized(grammar, "bbbba"), "bbbba is not recognized");
+}
+
+void testIsRecognizedWithNullableChains() {
+	// every symbol but a is nullable only through other nullable symbols
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	vector<Rule> rules = {
+		{"S'", {"S"}},
+		{"S", {"A", "B", "A"}},
+		{"A", {"B", "B"}},
+		{"A", {"a"}},
+		{"B", {"C"}},
+		{"C", {"epsilon"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+	EarleyAlgorithm earley_algorithm;
+	Assert(earley_algorithm.isRecognized(grammar, ""), "empty word is recognized");
+	Assert(earley_algorithm.isRecognized(grammar, "a"), "a is recognized");
+	Assert(earley_algorithm.isRecognized(grammar, "aa"), "aa is recognized");
+	Assert(!earley_algorithm.isRecognized(grammar, "aaa"), "aaa is not recognized");
+}
+
+void testIsRecognizedWithEpsilonRules() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S'");
+	vector<Rule> rules = {
+		{"S'", {"S"}},
+		{"S", {"epsilon"}},
+		{"S", {"a", "S", "b"}}
+	};
+	for (unsigned i = 0; i < rules.size(); ++i) {
+		grammar.addRule(rules[i]);
+	}
+	Assert(EarleyAlgorithm().isRecognized(grammar, ""), "empty word is recognized");
+	Assert(EarleyAlgorithm().isRecognized(grammar, "aaabbb"), "aaabbb is recognized");
+	Assert(!EarleyAlgorithm().isRecognized(grammar, "aabbb"), "aabbb is not recognized");
+}
+
+void testRecognizeLines() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"(", "S", ")", "S"}});
+	grammar.addRule({"S", {}});
+	CompiledGrammar compiled_grammar(grammar);
+
+	istringstream input("()\n(()\n\n(())()\r\n)(");
+	ostringstream output;
+	recognizeLines(compiled_grammar, input, output);
+	AssertEqual(output.str(), "1\n0\n1\n1\n0\n");
+}
+
+void testRecognizeBatch() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"(", "S", ")", "S"}});
+	grammar.addRule({"S", {}});
+	CompiledGrammar compiled_grammar(grammar);
+
+	vector<string> inputs;
+	vector<bool> expected;
+	EarleyAlgorithm earley_algorithm;
+	for (int i = 0; i < 1000; ++i) {
+		string s;
+		for (int j = 0; j < i % 13; ++j) {
+			s += ((i >> (j % 10)) & 1) ? '(' : ')';
+		}
+		inputs.push_back(s);
+		expected.push_back(earley_algorithm.isRecognized(compiled_grammar, s));
+	}
+	for (unsigned threads_number : {1, 2, 3, 8}) {
+		Assert(recognizeBatch(compiled_grammar, inputs, threads_number) == expected,
+				std::to_string(threads_number) + " threads");
+	}
+	Assert(recognizeBatch(compiled_grammar, {}, 4).empty(), "empty batch");
+
+	istringstream input("()\n)(\n(())\n");
+	ostringstream output;
+	recognizeLines(compiled_grammar, input, output, 3);
+	AssertEqual(output.str(), "1\n0\n1\n");
+}
+
+void testIncrementalRecognition() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"(", "S", ")", "S"}});
+	grammar.addRule({"S", {"[", "A", "]"}});
+	grammar.addRule({"S", {}});
+	grammar.addRule({"A", {"a", "A"}}); // A derives no string
+	CompiledGrammar compiled_grammar(grammar);
+	Assert(!compiled_grammar.isProductive(compiled_grammar.symbols().find("A")), "A is unproductive");
+
+	EarleyAlgorithm earley_algorithm;
+	earley_algorithm.reset(compiled_grammar);
+	Assert(earley_algorithm.accepts(), "empty string is recognized");
+	Assert(earley_algorithm.expectedTerminals() == vector<string>({"("}),
+			"[ can't be continued since A derives nothing");
+	Assert(earley_algorithm.feed('('), "( is a viable prefix");
+	Assert(!earley_algorithm.accepts(), "( is not recognized");
+	Assert(earley_algorithm.expectedTerminals() == vector<string>({"(", ")"}), "after (");
+	Assert(earley_algorithm.feed(")("), "()( is a viable prefix");
+	Assert(earley_algorithm.feed(')'), "()() is a viable prefix");
+	Assert(earley_algorithm.accepts(), "()() is recognized");
+	Assert(!earley_algorithm.feed(')'), "()()) is not a viable prefix");
+	Assert(earley_algorithm.expectedTerminals().empty(), "nothing continues ()())");
+	Assert(!earley_algorithm.feed('('), "a dead prefix stays dead");
+
+	earley_algorithm.reset(compiled_grammar);
+	Assert(!earley_algorithm.feed('['), "[ is not a viable prefix");
+	Assert(earley_algorithm.columnSituations(1).empty(), "nothing is scanned from [");
+	vector<Situation> first_column = earley_algorithm.columnSituations(0);
+	Situation start_situation{compiled_grammar.ruleFirstItem(compiled_grammar.startRule()), 0};
+	Assert(std::find(first_column.begin(), first_column.end(), start_situation) != first_column.end(),
+			"the first column starts with S'->.S");
+	Assert(earley_algorithm.isRecognized(compiled_grammar, "(())"), "(()) is recognized");
+
+	Grammar empty_language;
+	empty_language.setStartingSymbol("S");
+	empty_language.addRule({"S", {"S"}});
+	CompiledGrammar empty_language_grammar(empty_language);
+	earley_algorithm.reset(empty_language_grammar);
+	Assert(!earley_algorithm.isViablePrefix(), "S derives nothing, so no prefix is viable");
+}
+
+void testTokenRecognition() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"\"while\"", "E", "\"do\"", "S"}});
+	grammar.addRule({"S", {"x", "\"=\"", "E"}});
+	grammar.addRule({"E", {"x"}});
+	grammar.addRule({"E", {"x", "\"+\"", "E"}});
+	grammar.addRule({"E", {"x", "\"<\"", "x"}});
+	grammar.addRule({"E", {"x", "\"<=\"", "x"}});
+	CompiledGrammar compiled_grammar(grammar);
+	const SymbolTable& symbols = compiled_grammar.symbols();
+	AssertEqual(compiled_grammar.terminalSymbol("while"), symbols.find("\"while\""));
+	AssertEqual(compiled_grammar.terminalSymbol("x"), symbols.find("x"));
+	AssertEqual(compiled_grammar.characterSymbol('<'), symbols.find("\"<\""));
+	AssertEqual(compiled_grammar.terminalSymbol("if"), -1);
+	AssertEqual(compiled_grammar.maxTerminalLength(), 5);
+
+	vector<int> tokens;
+	WhitespaceLexer().tokenize(compiled_grammar, " while x < x  do x = x + x", tokens);
+	AssertEqual(tokens.size(), 10u);
+	AssertEqual(tokens[0], compiled_grammar.terminalSymbol("while"));
+	EarleyAlgorithm earley_algorithm;
+	Assert(earley_algorithm.isRecognized(compiled_grammar, tokens), "a loop is recognized");
+	earley_algorithm.reset(compiled_grammar);
+	earley_algorithm.feed(tokens);
+	AssertEqual(earley_algorithm.D_situations_.columnsNumber(), 11u, "one column per token");
+	Assert(earley_algorithm.accepts(), "the loop is fed token by token");
+	Assert(earley_algorithm.edit(1, 3, vector<int>{compiled_grammar.terminalSymbol("x")}),
+			"while x do x = x + x is a viable prefix");
+	Assert(earley_algorithm.accepts(), "while x do x = x + x is recognized");
+	Assert(!earley_algorithm.feedToken(-1), "no terminal continues the input");
+
+	LongestMatchLexer().tokenize(compiled_grammar, "whilex<=xdo x=x", tokens);
+	AssertEqual(tokens.size(), 8u);
+	AssertEqual(tokens[2], compiled_grammar.terminalSymbol("<="), "the longest token is taken");
+	Assert(earley_algorithm.isRecognized(compiled_grammar, tokens), "whilex<=xdo x=x is recognized");
+	LongestMatchLexer().tokenize(compiled_grammar, "x = y", tokens);
+	AssertEqual(tokens.back(), -1, "y is no terminal");
+	Assert(!earley_algorithm.isRecognized(compiled_grammar, tokens), "x = y is not recognized");
+
+	earley_algorithm.reset(compiled_grammar);
+	earley_algorithm.feedToken(compiled_grammar.terminalSymbol("while"));
+	Assert(earley_algorithm.expectedTerminals() == vector<string>({"x"}), "after while");
+
+	vector<string> inputs = {"x = x", "while do", "while x do x = x + x", "x = x +", ""};
+	vector<bool> expected = {true, false, true, false, false};
+	WhitespaceLexer whitespace_lexer;
+	for (unsigned threads_number : {1, 2}) {
+		Assert(recognizeBatch(compiled_grammar, inputs, threads_number, &whitespace_lexer) == expected,
+				std::to_string(threads_number) + " threads");
+	}
+	istringstream input("x = x + x\nx x\n");
+	ostringstream output;
+	recognizeLines(compiled_grammar, input, output, 1, &whitespace_lexer);
+	AssertEqual(output.str(), "1\n0\n");
+
+	Grammar ambiguous_tokens;
+	ambiguous_tokens.setStartingSymbol("S");
+	ambiguous_tokens.addRule({"S", {"a", "\"a\""}});
+	bool thrown = false;
+	try {
+		CompiledGrammar compiled_ambiguous_tokens(ambiguous_tokens);
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	Assert(thrown, "a and \"a\" can't be told apart in the input");
+}
+
+// the terminals of the first tree of the node
+void appendFirstYield(const CompiledGrammar& grammar, const ParseForest& forest, int node_number,
+		string& yield) {
+	if (node_number == ParseForest::none) {
+		return;
+	}
+	const ParseForest::Node& node = forest.node(node_number);
+	if (node.packed_begin == node.packed_end) {
+		yield += grammar.symbols().name(node.symbol);
+		return;
+	}
+	appendFirstYield(grammar, forest, forest.packedNode(node.packed_begin).left, yield);
+	appendFirstYield(grammar, forest, forest.packedNode(node.packed_begin).right, yield);
+}
+
+void testParseForest() {
+	Grammar brackets;
+	brackets.setStartingSymbol("S");
+	brackets.addRule({"S", {"(", "S", ")", "S"}});
+	brackets.addRule({"S", {}});
+	CompiledGrammar brackets_grammar(brackets);
+	EarleyAlgorithm earley_algorithm;
+	earley_algorithm.reset(brackets_grammar, true);
+	earley_algorithm.feed("(()())()");
+	ParseForest forest = earley_algorithm.parseForest();
+	AssertEqual(countTrees(forest), 1u, "the bracket grammar is unambiguous");
+	for (int node_number = 0; node_number < forest.nodesNumber(); ++node_number) {
+		const ParseForest::Node& node = forest.node(node_number);
+		Assert(node.packed_end - node.packed_begin <= 1, "every node has one derivation");
+	}
+	const ParseForest::Node& root = forest.node(forest.root());
+	AssertEqual(brackets_grammar.symbols().name(root.symbol), "S");
+	AssertEqual(root.begin, 0u);
+	AssertEqual(root.end, 8u);
+	string yield;
+	appendFirstYield(brackets_grammar, forest, forest.root(), yield);
+	AssertEqual(yield, "(()())()");
+	earley_algorithm.feed(')');
+	AssertEqual(earley_algorithm.parseForest().root(), ParseForest::none, "(()())()) is not recognized");
+	Assert(!earley_algorithm.accepts(), "(()())()) is not recognized");
+
+	// S--->S S is as ambiguous as it gets: the trees of n letters are counted
+	// by Catalan numbers, but the forest stays cubic
+	Grammar pairs;
+	pairs.setStartingSymbol("S");
+	pairs.addRule({"S", {"S", "S"}});
+	pairs.addRule({"S", {"a"}});
+	CompiledGrammar pairs_grammar(pairs);
+	vector<uint64_t> catalan_numbers = {1, 1, 2, 5, 14, 42, 132, 429, 1430, 4862, 16796, 58786};
+	for (unsigned length = 1; length < catalan_numbers.size(); ++length) {
+		earley_algorithm.reset(pairs_grammar, true);
+		earley_algorithm.feed(string(length, 'a'));
+		forest = earley_algorithm.parseForest();
+		AssertEqual(countTrees(forest), catalan_numbers[length - 1], std::to_string(length) + " letters");
+		Assert(forest.packedNodesNumber() <= static_cast<int>(length * length * length),
+				"packed nodes are shared");
+	}
+
+	// nullable symbols are stepped over, but their empty derivations are in the forest
+	Grammar nullable;
+	nullable.setStartingSymbol("S");
+	nullable.addRule({"S", {"A", "A", "a"}});
+	nullable.addRule({"A", {"a"}});
+	nullable.addRule({"A", {}});
+	CompiledGrammar nullable_grammar(nullable);
+	earley_algorithm.reset(nullable_grammar, true);
+	earley_algorithm.feed("aa");
+	forest = earley_algorithm.parseForest();
+	AssertEqual(countTrees(forest), 2u, "either A derives a");
+
+	// S--->S makes the forest cyclic: the root is one of its own derivations
+	Grammar cyclic;
+	cyclic.setStartingSymbol("S");
+	cyclic.addRule({"S", {"S"}});
+	cyclic.addRule({"S", {"a"}});
+	CompiledGrammar cyclic_grammar(cyclic);
+	earley_algorithm.reset(cyclic_grammar, true);
+	earley_algorithm.feed("a");
+	forest = earley_algorithm.parseForest();
+	const ParseForest::Node& cyclic_root = forest.node(forest.root());
+	bool derives_itself = false;
+	for (uint32_t i = cyclic_root.packed_begin; i < cyclic_root.packed_end; ++i) {
+		derives_itself = derives_itself || forest.packedNode(i).right == forest.root();
+	}
+	Assert(derives_itself, "S derives S");
+	AssertEqual(countTrees(forest), many_trees, "S derives S any number of times");
+
+	// building the forest doesn't change what is recognized, though Leo's optimization is off
+	EarleyAlgorithm building_forest;
+	const string alphabet = "()";
+	for (int mask = 0; mask < (1 << 10); ++mask) {
+		string s;
+		for (int i = 0; i < mask % 11; ++i) {
+			s += alphabet[(mask >> i) & 1];
+		}
+		building_forest.reset(brackets_grammar, true);
+		building_forest.feed(s);
+		AssertEqual(building_forest.accepts(), earley_algorithm.isRecognized(brackets_grammar, s), s);
+		AssertEqual(building_forest.parseForest().root() != ParseForest::none,
+				building_forest.accepts(), s);
+	}
+	bool thrown = false;
+	try {
+		building_forest.edit(0, 0, "(");
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	Assert(thrown, "inputs of parse forests can't be edited");
+}
+
+string treeText(const CompiledGrammar& grammar, const ParseTree& tree) {
+	std::ostringstream os;
+	tree.print(os, grammar);
+	return os.str();
+}
+
+void testParseTrees() {
+	Grammar brackets;
+	brackets.setStartingSymbol("S");
+	brackets.addRule({"S", {"(", "S", ")", "S"}});
+	brackets.addRule({"S", {}});
+	CompiledGrammar brackets_grammar(brackets);
+	EarleyAlgorithm earley_algorithm;
+	earley_algorithm.reset(brackets_grammar, true);
+	earley_algorithm.feed("()");
+	ParseForest forest = earley_algorithm.parseForest();
+	TreeEnumerator brackets_trees(brackets_grammar, forest);
+	ParseTree tree;
+	Assert(brackets_trees.next(tree), "() has a tree");
+	AssertEqual(treeText(brackets_grammar, tree), "S(( S() ) S())");
+	AssertEqual(tree.nodesNumber(), 5);
+	const ParseTree::Node& root = tree.node(0);
+	AssertEqual(root.children_end - root.children_begin, 4u);
+	AssertEqual(root.rule, 0);
+	const ParseTree::Node& last_child = tree.node(tree.child(root.children_end - 1));
+	AssertEqual(last_child.begin, 2u);
+	AssertEqual(last_child.end, 2u);
+	AssertEqual(last_child.rule, 1);
+	Assert(!brackets_trees.next(tree), "() has one tree");
+	Assert(!brackets_trees.next(tree), "the enumeration stays finished");
+
+	// every tree of S--->S S is listed once
+	Grammar pairs;
+	pairs.setStartingSymbol("S");
+	pairs.addRule({"S", {"S", "S"}});
+	pairs.addRule({"S", {"a"}});
+	CompiledGrammar pairs_grammar(pairs);
+	for (int length = 1; length <= 8; ++length) {
+		earley_algorithm.reset(pairs_grammar, true);
+		earley_algorithm.feed(string(length, 'a'));
+		forest = earley_algorithm.parseForest();
+		TreeEnumerator pairs_trees(pairs_grammar, forest);
+		std::set<string> texts;
+		uint64_t trees_number = 0;
+		while (pairs_trees.next(tree)) {
+			++trees_number;
+			texts.insert(treeText(pairs_grammar, tree));
+			AssertEqual(tree.nodesNumber(), 3 * length - 1);
+		}
+		AssertEqual(trees_number, countTrees(forest), std::to_string(length) + " letters");
+		AssertEqual(texts.size(), trees_number, "trees are different");
+
+		vector<ParseTree> best_trees = bestTrees(pairs_grammar, forest, {1, 0}, 1000);
+		AssertEqual(best_trees.size(), trees_number, "all trees are among the best ones");
+		for (const ParseTree& best_tree : best_trees) {
+			texts.erase(treeText(pairs_grammar, best_tree));
+			AssertEqual(best_tree.cost({1, 0}), length - 1.0);
+		}
+		Assert(texts.empty(), "the best trees are the enumerated ones");
+	}
+
+	// S--->A | B, A--->a and B--->a: B costs less
+	Grammar costs;
+	costs.setStartingSymbol("S");
+	costs.addRule({"S", {"A"}});
+	costs.addRule({"S", {"B"}});
+	costs.addRule({"A", {"a"}});
+	costs.addRule({"B", {"a"}});
+	CompiledGrammar costs_grammar(costs);
+	earley_algorithm.reset(costs_grammar, true);
+	earley_algorithm.feed("a");
+	forest = earley_algorithm.parseForest();
+	vector<ParseTree> best_trees = bestTrees(costs_grammar, forest, {0, 0, 2, 1}, 5);
+	AssertEqual(best_trees.size(), 2u);
+	AssertEqual(treeText(costs_grammar, best_trees[0]), "S(B(a))");
+	AssertEqual(treeText(costs_grammar, best_trees[1]), "S(A(a))");
+	AssertEqual(bestTrees(costs_grammar, forest, {0, 0, 2, 1}, 1).size(), 1u);
+	bool thrown = false;
+	try {
+		bestTrees(costs_grammar, forest, {0, 0, 2}, 1);
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	Assert(thrown, "every rule needs a cost");
+
+	// trees in which a node derives itself are skipped
+	Grammar cyclic;
+	cyclic.setStartingSymbol("S");
+	cyclic.addRule({"S", {"S"}});
+	cyclic.addRule({"S", {"a"}});
+	CompiledGrammar cyclic_grammar(cyclic);
+	earley_algorithm.reset(cyclic_grammar, true);
+	earley_algorithm.feed("a");
+	forest = earley_algorithm.parseForest();
+	TreeEnumerator cyclic_trees(cyclic_grammar, forest);
+	Assert(cyclic_trees.next(tree), "a has a tree");
+	AssertEqual(treeText(cyclic_grammar, tree), "S(a)");
+	Assert(!cyclic_trees.next(tree), "the other trees of a repeat S");
+	thrown = false;
+	try {
+		bestTrees(cyclic_grammar, forest, {0, 0}, 1);
+	} catch (const runtime_error&) {
+		thrown = true;
+	}
+	Assert(thrown, "S--->S costs nothing, so there are infinitely many best trees");
+
+	// no recursion over trees: a left recursive list is as deep as it is long
+	Grammar list;
+	list.setStartingSymbol("S");
+	list.addRule({"S", {"S", "a"}});
+	list.addRule({"S", {"a"}});
+	CompiledGrammar list_grammar(list);
+	const int list_length = 100000;
+	earley_algorithm.reset(list_grammar, true);
+	earley_algorithm.feed(string(list_length, 'a'));
+	forest = earley_algorithm.parseForest();
+	TreeEnumerator list_trees(list_grammar, forest);
+	Assert(list_trees.next(tree), "a long list has a tree");
+	AssertEqual(tree.nodesNumber(), 2 * list_length);
+	Assert(!list_trees.next(tree), "a long list has one tree");
+	best_trees = bestTrees(list_grammar, forest, {1, 1}, 3);
+	AssertEqual(best_trees.size(), 1u);
+	AssertEqual(best_trees[0].cost({1, 1}), static_cast<double>(list_length));
+	std::ostringstream os;
+	best_trees[0].print(os, list_grammar);
+	AssertEqual(os.str().size(), 5u * list_length - 1, "S(...S(a) a...) a)");
+}
+
+void testEditing() {
+	Grammar grammar;
+	grammar.setStartingSymbol("S");
+	grammar.addRule({"S", {"(", "S", ")", "S"}});
+	grammar.addRule({"S", {"[", "S", "]", "S"}});
+	grammar.addRule({"S", {"a", "S"}});
+	grammar.addRule({"S", {}});
+	CompiledGrammar compiled_grammar(grammar);
+
+	EarleyAlgorithm edited;
+	EarleyAlgorithm rebuilt;
+	string input = "(a[a])a";
+	edited.reset(compiled_grammar);
+	edited.feed(input);
+	const string alphabet = "()[]a";
+	unsigned random_state = 12345;
+	auto random = [&random_state](unsigned bound) {
+		random_state = random_state * 1103515245 + 12345;
+		return (random_state >> 16) % bound;
+	};
+	for (int edit_number = 0; edit_number < 300; ++edit_number) {
+		size_t position = random(input.size() + 1);
+		size_t erased_length = random(std::min<size_t>(3, input.size() - position) + 1);
+		string text;
+		for (unsigned i = random(3); i > 0; --i) {
+			text += alphabet[random(alphabet.size())];
+		}
+		string expected_input = input.replace(position, erased_length, text);
+		edited.edit(position, erased_length, text);
+		AssertEqual(edited.tokens().size(), expected_input.size());
+		for (unsigned i = 0; i < expected_input.size(); ++i) {
+			AssertEqual(edited.tokens()[i], compiled_grammar.characterSymbol(expected_input[i]));
+		}
+
+		// the edited chart is the chart of the new input
+		rebuilt.reset(compiled_grammar);
+		rebuilt.feed(expected_input);
+		AssertEqual(edited.D_situations_.columnsNumber(), rebuilt.D_situations_.columnsNumber());
+		auto sortedColumn = [](const Chart& chart, int d_number) {
+			vector<uint64_t> keys;
+			for (uint32_t k = chart.columnBegin(d_number); k < chart.columnEnd(d_number); ++k) {
+				keys.push_back(packSituation(chart[k]));
+			}
+			std::sort(keys.begin(), keys.end());
+			return keys;
+		};
+		for (uint32_t d = 0; d < rebuilt.D_situations_.columnsNumber(); ++d) {
+			Assert(sortedColumn(edited.D_situations_, d) == sortedColumn(rebuilt.D_situations_, d),
+					expected_input + ", column " + std::to_string(d));
+		}
+		AssertEqual(edited.accepts(), rebuilt.accepts(), expected_input);
+		Assert(edited.expectedTerminals() == rebuilt.expectedTerminals(), expected_input);
+		// typing at the end keeps working after an edit
+		edited.feed('a');
+		rebuilt.feed('a');
+		AssertEqual(edited.accepts(), rebuilt.accepts(), expected_input + "a");
+		edited.edit(input.size(), 1, "");
+	}
+}
+
+void testCyk() {
+	// the grammars are brought to Chomsky form, CYK on it agrees with Earley on the original
+	vector<pair<Grammar, string>> grammars = {
+		{makeGrammar("S", {{"S", {"(", "S", ")", "S"}}, {"S", {"epsilon"}}}), "()"},
+		{makeGrammar("S", {
+			{"S", {"(", "S", ")", "S"}},
+			{"S", {"[", "S", "]", "S"}},
+			{"S", {"a", "S"}},
+			{"S", {"epsilon"}},
+		}), "()[a"},
+		{makeGrammar("S", {{"S", {"a", "S", "b"}}, {"S", {"a", "b"}}}), "ab"},
+		{makeGrammar("S", {{"S", {"S", "S"}}, {"S", {"a"}}, {"S", {"S", "b"}}}), "ab"},
+	};
+	EarleyAlgorithm earley_algorithm;
+	CykAlgorithm cyk_algorithm;
+	for (const auto& grammar_and_alphabet : grammars) {
+		const Grammar& grammar = grammar_and_alphabet.first;
+		const string& alphabet = grammar_and_alphabet.second;
+		CykGrammar cyk_grammar(toChomskyForm(grammar));
+		vector<string> strings = {""};
+		for (size_t i = 0; i < strings.size(); ++i) {
+			AssertEqual(cyk_algorithm.isRecognized(cyk_grammar, strings[i]),
+					earley_algorithm.isRecognized(grammar, strings[i]), strings[i]);
+			if (strings[i].size() < 7) {
+				for (char c : alphabet) {
+					strings.push_back(strings[i] + c);
+				}
+			}
+		}
+		Assert(!cyk_algorithm.isRecognized(cyk_grammar, "x"), "x is no terminal");
+	}
+
+	Grammar chomsky_grammar = makeGrammar("S", {
+		{"S", {"A", "B"}},
+		{"S", {"epsilon"}},
+		{"A", {"a"}},
+		{"B", {"b"}},
+		{"B", {"B", "B"}},
+	});
+	CykGrammar cyk_grammar(chomsky_grammar);
+	AssertEqual(cyk_grammar.nonterminalsNumber(), 3);
+	AssertEqual(cyk_grammar.wordsNumber(), 1);
+	Assert(cyk_algorithm.isRecognized(cyk_grammar, ""), "S derives epsilon");
+	Assert(cyk_algorithm.isRecognized(chomsky_grammar, "abbb"), "abbb is recognized");
+	Assert(!cyk_algorithm.isRecognized(cyk_grammar, "abab"), "abab is not recognized");
+	vector<int> tokens = {cyk_grammar.compiledGrammar().characterSymbol('a'), -1};
+	Assert(!cyk_algorithm.isRecognized(cyk_grammar, tokens), "-1 is a token of no terminal");
+
+	vector<Grammar> not_chomsky = {
+		makeGrammar("S", {{"S", {"a", "B"}}, {"B", {"b"}}}),
+		makeGrammar("S", {{"S", {"A"}}, {"A", {"a"}}}),
+		makeGrammar("S", {{"S", {"A", "A"}}, {"A", {"a"}}, {"A", {"epsilon"}}}),
+		makeGrammar("S", {{"S", {"S", "S"}}, {"S", {"a"}}, {"S", {"epsilon"}}}),
+	};
+	for (const Grammar& grammar : not_chomsky) {
+		bool thrown = false;
+		try {
+			CykGrammar not_chomsky_grammar(grammar);
+		} catch (const runtime_error&) {
+			thrown = true;
+		}
+		Assert(thrown, "the grammar isn't in Chomsky form");
+	}
+
+	// more than 64 nonterminals take several words: A_i derives a^(2^i)
+	Grammar powers;
+	powers.setStartingSymbol("A_100");
+	powers.addRule({"A_0", {"a"}});
+	for (int i = 1; i <= 100; ++i) {
+		string previous = "A_" + std::to_string(i - 1);
+		powers.addRule({"A_" + std::to_string(i), {previous, previous}});
+	}
+	powers.addRule({"A_100", {"A_3", "A_0"}});
+	CykGrammar cyk_powers(powers);
+	AssertEqual(cyk_powers.wordsNumber(), 2);
+	Assert(cyk_algorithm.isRecognized(cyk_powers, string(9, 'a')), "A_100--->A_3 A_0 derives a^9");
+	Assert(!cyk_algorithm.isRecognized(cyk_powers, string(8, 'a')), "a^8 is not recognized");
+
+	// inputs of several tiles: the result doesn't depend on the number of threads
+	Grammar brackets = makeGrammar("S", {{"S", {"(", "S", ")", "S"}}, {"S", {"epsilon"}}});
+	CykGrammar cyk_brackets(toChomskyForm(brackets));
+	CykAlgorithm threads_cyk_algorithm(3);
+	unsigned random_state = 12345;
+	for (int input_number = 0; input_number < 30; ++input_number) {
+		string s;
+		int depth = 0;
+		for (int i = 0; i < 300; ++i) {
+			random_state = random_state * 1103515245 + 12345;
+			bool is_closing = depth > 0 && ((random_state >> 16) % 2 == 0 || i + depth >= 300);
+			s += is_closing ? ')' : '(';
+			depth += is_closing ? -1 : 1;
+		}
+		if (input_number % 3 == 0) {
+			std::swap(s[input_number], s[s.size() - input_number - 1]);
+		}
+		bool is_recognized = earley_algorithm.isRecognized(brackets, s);
+		AssertEqual(cyk_algorithm.isRecognized(cyk_brackets, s), is_recognized, s);
+		AssertEqual(threads_cyk_algorithm.isRecognized(cyk_brackets, s), is_recognized, s);
+	}
+	string ambiguous(500, 'a');
+	Grammar ambiguous_grammar = makeGrammar("S", {{"S", {"S", "S"}}, {"S", {"a"}}});
+	Assert(threads_cyk_algorithm.isRecognized(ambiguous_grammar, ambiguous), "a^500 is recognized");
+	ambiguous[321] = 'b';
+	Assert(!threads_cyk_algorithm.isRecognized(ambiguous_grammar, ambiguous), "b is not derived");
+}
+
 void runTests() {
 	TestRunner test_runner;
 	test_runner.RunTest(testIsAlphabetSymbol, "test determining alphabet symbols");
+	test_runner.RunTest(testGrammarIndexes, "test grammar rule and symbol indexes");
 	test_runner.RunTest(testRemoveEpsilon, "test remove epsilon");
 	test_runner.RunTest(testClassifyRuleChomskyToGreybuh, "test rule classifying");
 	test_runner.RunTest(testChomskyToGreybuh, "test Chomsky to Greybuh");
+	test_runner.RunTest(testNormalization, "test normalization passes");
+	test_runner.RunTest(testSymbolTable, "test symbol table");
 	test_runner.RunTest(testSituationsOperatorEqual, "test operator == for situations");
 	test_runner.RunTest(testPrintingSituations, "test printing situations");
-	test_runner.RunTest(testSituationHash, "test situations hash");
+	test_runner.RunTest(testCompiledGrammar, "test compiled grammar");
+	test_runner.RunTest(testCompiledGrammarFile, "test saving and loading compiled grammars");
+	test_runner.RunTest(testPackingSituations, "test packing situations");
+	test_runner.RunTest(testItemSet, "test item set");
+	test_runner.RunTest(testChartWaitingIndex, "test chart waiting index");
 	test_runner.RunTest(testPredict, "test predict in earley algorithm");
 	test_runner.RunTest(testComplete, "test complete in earley algorithm");
 	test_runner.RunTest(testScan, "test scan in earley algorithm");
+	test_runner.RunTest(testPredictionClosure, "test prediction closure");
 	test_runner.RunTest(testSituationsUpdating, "test situations updating");
+	test_runner.RunTest(testScanIndex, "test scanning by terminal index");
+	test_runner.RunTest(testLeoRightRecursion, "test leo's right recursion optimization");
 	test_runner.RunTest(testIsRecognized, "test earley algorithm 'is recognized' function");
+	test_runner.RunTest(testNullableCompletedBeforeWaiting,
+			"test earley algorithm with nullable symbols completed early");
+	test_runner.RunTest(testIsRecognizedWithNullableChains,
+			"test earley algorithm with chains of nullable symbols");
+	test_runner.RunTest(testIsRecognizedWithEpsilonRules,
+			"test earley algorithm with epsilon rules");
+	test_runner.RunTest(testIncrementalRecognition, "test incremental recognition");
+	test_runner.RunTest(testTokenRecognition, "test recognizing tokens of multi-character terminals");
+	test_runner.RunTest(testParseForest, "test building shared packed parse forests");
+	test_runner.RunTest(testParseTrees, "test listing parse trees and the best ones");
+	test_runner.RunTest(testEditing, "test editing the input of incremental recognition");
+	test_runner.RunTest(testCyk, "test bit-parallel CYK algorithm");
+	test_runner.RunTest(testRecognizeLines, "test recognizing newline-delimited strings");
+	test_runner.RunTest(testRecognizeBatch, "test recognizing a batch of strings in several threads");
 }
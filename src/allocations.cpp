@@ -0,0 +1,23 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// every allocation of the benchmark binary is counted, see benchmarkChartAllocations.
+// The replacements live apart from the benchmarks, so they aren't inlined into them
+std::atomic<size_t> allocations_number(0);
+
+void* operator new(size_t size) {
+	allocations_number.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
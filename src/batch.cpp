@@ -0,0 +1,155 @@
+#include "batch.h"
+#include "earley.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using std::deque;
+using std::getline;
+using std::lock_guard;
+using std::max;
+using std::min;
+using std::mutex;
+using std::pair;
+using std::thread;
+
+// a deque of [begin, end) ranges of inputs: the owner takes ranges from the
+// front, so it walks its inputs in order, and idle threads steal from the back
+class WorkStealingQueue {
+public:
+	void push(size_t begin, size_t end) {
+		lock_guard<mutex> lock(mutex_);
+		ranges_.push_back({begin, end});
+	}
+
+	bool pop(pair<size_t, size_t>& range) {
+		lock_guard<mutex> lock(mutex_);
+		if (ranges_.empty()) {
+			return false;
+		}
+		range = ranges_.front();
+		ranges_.pop_front();
+		return true;
+	}
+
+	bool steal(pair<size_t, size_t>& range) {
+		lock_guard<mutex> lock(mutex_);
+		if (ranges_.empty()) {
+			return false;
+		}
+		range = ranges_.back();
+		ranges_.pop_back();
+		return true;
+	}
+
+private:
+	mutex mutex_;
+	deque<pair<size_t, size_t>> ranges_;
+};
+
+static const size_t inputs_per_range = 64;
+
+// the recognizer and the token buffer are reused by the calls of one thread
+static bool recognize(EarleyAlgorithm& earley_algorithm, const CompiledGrammar& grammar,
+		const string& input, const Lexer* lexer, vector<int>& tokens) {
+	if (lexer == nullptr) {
+		return earley_algorithm.isRecognized(grammar, input);
+	}
+	lexer->tokenize(grammar, input, tokens);
+	return earley_algorithm.isRecognized(grammar, tokens);
+}
+
+static void recognizeRanges(const CompiledGrammar& grammar, const vector<string>& inputs,
+		const Lexer* lexer, vector<WorkStealingQueue>& queues, unsigned thread_number,
+		vector<char>& results) {
+	// the chart and the scratch arrays of a recognizer belong to one thread
+	EarleyAlgorithm earley_algorithm;
+	vector<int> tokens;
+	pair<size_t, size_t> range;
+	while (true) {
+		bool found = queues[thread_number].pop(range);
+		// no new work appears while recognizing, so once every queue is empty the thread is done
+		for (unsigned i = 1; !found && i < queues.size(); ++i) {
+			found = queues[(thread_number + i) % queues.size()].steal(range);
+		}
+		if (!found) {
+			return;
+		}
+		for (size_t i = range.first; i < range.second; ++i) {
+			results[i] = recognize(earley_algorithm, grammar, inputs[i], lexer, tokens);
+		}
+	}
+}
+
+vector<bool> recognizeBatch(const CompiledGrammar& grammar, const vector<string>& inputs,
+		unsigned threads_number, const Lexer* lexer) {
+	if (threads_number == 0) {
+		threads_number = max(thread::hardware_concurrency(), 1u);
+	}
+	size_t ranges_number = (inputs.size() + inputs_per_range - 1) / inputs_per_range;
+	threads_number = max<size_t>(min<size_t>(threads_number, ranges_number), 1);
+
+	// vector<bool> packs bits, so threads can't write neighbouring results into it
+	vector<char> results(inputs.size());
+	vector<WorkStealingQueue> queues(threads_number);
+	// every thread starts with a contiguous block of ranges
+	for (size_t i = 0; i < ranges_number; ++i) {
+		queues[i * threads_number / ranges_number].push(
+				i * inputs_per_range, min(inputs.size(), (i + 1) * inputs_per_range));
+	}
+	vector<thread> threads;
+	for (unsigned i = 1; i < threads_number; ++i) {
+		threads.emplace_back(recognizeRanges, std::cref(grammar), std::cref(inputs), lexer,
+				std::ref(queues), i, std::ref(results));
+	}
+	recognizeRanges(grammar, inputs, lexer, queues, 0, results);
+	for (auto& worker : threads) {
+		worker.join();
+	}
+	return vector<bool>(results.begin(), results.end());
+}
+
+static const size_t lines_per_batch = 1 << 16;
+
+void recognizeLines(const CompiledGrammar& grammar, istream& input, ostream& output,
+		unsigned threads_number, const Lexer* lexer) {
+	if (threads_number == 1) {
+		EarleyAlgorithm earley_algorithm;
+		vector<int> tokens;
+		string s;
+		while (getline(input, s)) {
+			if (!s.empty() && s.back() == '\r') {
+				s.pop_back();
+			}
+			output << (recognize(earley_algorithm, grammar, s, lexer, tokens) ? '1' : '0') << '\n';
+		}
+		output.flush();
+		return;
+	}
+	// the input is still streamed, but in batches big enough to keep every thread busy
+	vector<string> lines;
+	string s;
+	bool input_ended = false;
+	while (!input_ended) {
+		lines.clear();
+		while (lines.size() < lines_per_batch) {
+			if (!getline(input, s)) {
+				input_ended = true;
+				break;
+			}
+			if (!s.empty() && s.back() == '\r') {
+				s.pop_back();
+			}
+			lines.push_back(std::move(s));
+		}
+		vector<bool> results = recognizeBatch(grammar, lines, threads_number, lexer);
+		for (bool result : results) {
+			output << (result ? '1' : '0') << '\n';
+		}
+	}
+	output.flush();
+}
@@ -0,0 +1,5 @@
+#include "benchmarks.h"
+
+int main() {
+	runBenchmarks();
+}
@@ -0,0 +1,202 @@
+#include "chart.h"
+
+#include <utility>
+
+ostream& operator << (ostream& os, const Situation& s) {
+	os << s.item << ' ' << s.deduced_prefix_length;
+	return os;
+}
+
+uint64_t packSituation(const Situation& s) {
+	return (static_cast<uint64_t>(s.deduced_prefix_length) << 32) | s.item;
+}
+
+Situation unpackSituation(uint64_t key) {
+	return Situation{static_cast<uint32_t>(key), static_cast<uint32_t>(key >> 32)};
+}
+
+bool operator == (const Situation& s1, const Situation& s2) {
+	return s1.item == s2.item && s1.deduced_prefix_length == s2.deduced_prefix_length;
+}
+
+void Chart::clear() {
+	items_.clear();
+	origins_.clear();
+	next_waiting_.clear();
+	columns_.clear();
+	detached_.clear();
+	next_column_id_ = 0;
+	dropped_situations_ = 0;
+	last_column_.clear();
+	waiting_symbols_.clear();
+	waiting_heads_.clear();
+	waiting_tails_.clear();
+	transitive_.clear();
+	completed_in_.clear();
+	link_heads_.clear();
+	link_next_.clear();
+	link_predecessors_.clear();
+}
+
+void Chart::addColumn() {
+	uint32_t end = items_.size();
+	uint32_t waiting_end = waiting_symbols_.size();
+	columns_.push_back(Column{end, end, waiting_end, waiting_end, next_column_id_++});
+	last_column_.clear();
+}
+
+void Chart::detach(int first_column) {
+	link_heads_.clear();
+	link_next_.clear();
+	link_predecessors_.clear();
+	detached_.assign(columns_.begin() + first_column, columns_.end());
+	columns_.resize(first_column);
+	indexLastColumn_();
+}
+
+void Chart::reattach(int first_detached, int origin_threshold, int shift) {
+	for (int j = 0; j < first_detached && j < static_cast<int>(detached_.size()); ++j) {
+		dropped_situations_ += detached_[j].end - detached_[j].begin;
+	}
+	for (int j = first_detached; j < static_cast<int>(detached_.size()); ++j) {
+		const Column& column = detached_[j];
+		if (shift != 0) {
+			for (uint32_t position = column.begin; position < column.end; ++position) {
+				if (static_cast<int>(origins_[position]) > origin_threshold) {
+					origins_[position] += shift;
+				}
+			}
+			for (uint32_t w = column.waiting_begin; w < column.waiting_end; ++w) {
+				if (transitive_[w] != unknown_transitive && transitive_[w] != no_transitive) {
+					Situation top = unpackSituation(transitive_[w]);
+					if (static_cast<int>(top.deduced_prefix_length) > origin_threshold) {
+						top.deduced_prefix_length += shift;
+						transitive_[w] = packSituation(top);
+					}
+				}
+			}
+		}
+		columns_.push_back(column);
+	}
+	detached_.clear();
+	// a buffer made mostly of dropped columns is copied, so it stays linear in the chart
+	if (dropped_situations_ > items_.size() - dropped_situations_) {
+		compact_();
+	}
+	indexLastColumn_();
+}
+
+void Chart::compact_() {
+	Chart compacted;
+	compacted.items_.reserve(items_.size() - dropped_situations_);
+	for (const Column& column : columns_) {
+		uint32_t begin = compacted.items_.size();
+		uint32_t waiting_begin = compacted.waiting_symbols_.size();
+		// chains never leave their column, so their links are moved with it
+		uint32_t offset = begin - column.begin;
+		for (uint32_t position = column.begin; position < column.end; ++position) {
+			compacted.items_.push_back(items_[position]);
+			compacted.origins_.push_back(origins_[position]);
+			uint32_t next = next_waiting_[position];
+			compacted.next_waiting_.push_back(next == npos ? npos : next + offset);
+		}
+		uint32_t id = compacted.next_column_id_++;
+		for (uint32_t w = column.waiting_begin; w < column.waiting_end; ++w) {
+			uint32_t symbol = static_cast<uint32_t>(waiting_symbols_[w]);
+			compacted.waiting_symbols_.insert((static_cast<uint64_t>(id) << 32) | symbol);
+			compacted.waiting_heads_.push_back(waiting_heads_[w] + offset);
+			compacted.waiting_tails_.push_back(waiting_tails_[w] + offset);
+			compacted.transitive_.push_back(transitive_[w]);
+			// ids are renumbered, but completions are only compared with the last column's
+			compacted.completed_in_.push_back(npos);
+		}
+		compacted.columns_.push_back(Column{begin, static_cast<uint32_t>(compacted.items_.size()),
+				waiting_begin, compacted.waiting_symbols_.size(), id});
+	}
+	*this = std::move(compacted);
+}
+
+void Chart::indexLastColumn_() {
+	last_column_.clear();
+	if (columns_.empty()) {
+		return;
+	}
+	for (uint32_t position = columns_.back().begin; position < columns_.back().end; ++position) {
+		last_column_.insert(packSituation((*this)[position]));
+	}
+}
+
+bool Chart::insert(const Situation& situation, int next_symbol) {
+	if (!last_column_.insert(packSituation(situation)).second) {
+		return false;
+	}
+	uint32_t position = items_.size();
+	items_.push_back(situation.item);
+	origins_.push_back(situation.deduced_prefix_length);
+	next_waiting_.push_back(npos);
+	Column& column = columns_.back();
+	column.end = items_.size();
+	if (next_symbol != -1) {
+		auto symbol_insert_result = waiting_symbols_.insert(
+				waitingKey_(columns_.size() - 1, next_symbol));
+		if (symbol_insert_result.second) {
+			waiting_heads_.push_back(position);
+			waiting_tails_.push_back(position);
+			transitive_.push_back(unknown_transitive);
+			completed_in_.push_back(npos);
+			column.waiting_end = waiting_symbols_.size();
+		} else {
+			uint32_t& tail = waiting_tails_[symbol_insert_result.first];
+			next_waiting_[tail] = position;
+			tail = position;
+		}
+	}
+	return true;
+}
+
+bool Chart::contains(const Situation& situation) const {
+	return last_column_.contains(packSituation(situation));
+}
+
+uint32_t Chart::firstWaiting(int d_number, int symbol) const {
+	uint32_t symbol_position = waiting_symbols_.find(waitingKey_(d_number, symbol));
+	if (symbol_position == ItemSet::npos) {
+		return npos;
+	}
+	return waiting_heads_[symbol_position];
+}
+
+uint32_t Chart::firstWaitingOnce(int d_number, int symbol) {
+	uint32_t symbol_position = waiting_symbols_.find(waitingKey_(d_number, symbol));
+	if (symbol_position == ItemSet::npos || completed_in_[symbol_position] == columns_.back().id) {
+		return npos;
+	}
+	completed_in_[symbol_position] = columns_.back().id;
+	return waiting_heads_[symbol_position];
+}
+
+uint64_t Chart::transitive(int d_number, int symbol) const {
+	uint32_t symbol_position = waiting_symbols_.find(waitingKey_(d_number, symbol));
+	if (symbol_position == ItemSet::npos) {
+		return no_transitive;
+	}
+	return transitive_[symbol_position];
+}
+
+void Chart::setTransitive(int d_number, int symbol, uint64_t key) {
+	transitive_[waiting_symbols_.find(waitingKey_(d_number, symbol))] = key;
+}
+
+uint32_t Chart::find(const Situation& situation) const {
+	uint32_t index = last_column_.find(packSituation(situation));
+	return index == ItemSet::npos ? npos : columns_.back().begin + index;
+}
+
+void Chart::addLink(uint32_t position, uint32_t predecessor) {
+	if (link_heads_.size() <= position) {
+		link_heads_.resize(items_.size(), npos);
+	}
+	link_next_.push_back(link_heads_[position]);
+	link_predecessors_.push_back(predecessor);
+	link_heads_[position] = link_next_.size() - 1;
+}
@@ -3,9 +3,12 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <thread>
+#include <tuple>
 
 #include "grammar.h"
 #include "chomsky_to_greybuh.h"
+#include "symbol_table.h"
 
 using std::string;
 using std::vector;
@@ -15,6 +18,10 @@ using std::runtime_error;
 using std::find;
 using std::endl;
 using std::cout;
+using std::max;
+using std::min;
+using std::pair;
+using std::thread;
 
 void processRule(Grammar& grammar, const Rule& rule) {
 	vector<bool> is_epsilon_generating(rule.to.size(), false);
@@ -90,56 +97,266 @@ int classifyRuleChomskyToGreybuh(const Rule& rule, const string& starting_symbol
     return rule.to.size();
 }
 
-Grammar chomskyToGreybuh(const Grammar& grammar) {
-    Grammar result_grammar;
-    result_grammar.setStartingSymbol(grammar.starting_symbol);
+namespace {
 
-    // A\A--->epsilon
-    for (unsigned int i = 0; i < grammar.symbols.size(); ++i) {
-        result_grammar.addRule({
-            grammar.symbols[i] + "\\" + grammar.symbols[i],
-            {"epsilon"}
-        });
-    }
+// A\B derives the words w such that B derives A w by a chain of left children
+// of binary rules; quotient A\B is numbered A * nonterminals_number + B
+struct GreibachRule {
+	int terminal;
+	int first; // quotients, -1 if the symbol is dropped
+	int second;
+};
 
-    for (unsigned rule_number = 0; rule_number < grammar.rules.size(); ++rule_number) {
-        Rule rule = grammar.rules[rule_number];
-        if (classifyRuleChomskyToGreybuh(rule, grammar.starting_symbol) == 0) {
-        	// starting_symbol ---> epsilon rule
-        	result_grammar.addRule(rule);
-        }
-        if (classifyRuleChomskyToGreybuh(rule, grammar.starting_symbol) == 1) {
-            result_grammar.addRule({
-                grammar.starting_symbol,
-                {rule.to[0], rule.from + "\\" + grammar.starting_symbol}
-            });
-        }
-    }
+bool operator < (const GreibachRule& rule1, const GreibachRule& rule2) {
+	return std::tie(rule1.terminal, rule1.first, rule1.second) <
+			std::tie(rule2.terminal, rule2.first, rule2.second);
+}
 
-    for (unsigned rule1_number = 0; rule1_number < grammar.rules.size(); ++rule1_number) {
-        Rule rule1 = grammar.rules[rule1_number];
-        if (classifyRuleChomskyToGreybuh(rule1, grammar.starting_symbol) != 1) {
-            continue;
-        }
-        for (unsigned rule2_number = 0; rule2_number < grammar.rules.size(); ++rule2_number) {
-            Rule rule2 = grammar.rules[rule2_number];
-            if (classifyRuleChomskyToGreybuh(rule2, grammar.starting_symbol) != 2) {
-                continue;
-            }
-            for (unsigned B_symbol_number = 0; B_symbol_number < grammar.symbols.size();
-                    ++B_symbol_number) {
-                string A_symbol = rule2.to[0];
-                string B_symbol = grammar.symbols[B_symbol_number];
-                string C_symbol = rule2.from;
-                string D_symbol = rule2.to[1];
-                string E_symbol = rule1.from;
-                string e_symbol = rule1.to[0];
-                result_grammar.addRule({
-                    A_symbol + "\\" + B_symbol,
-                    {e_symbol, E_symbol + "\\" + D_symbol, C_symbol + "\\" + B_symbol}
-                });
-            }
-        }
-    }
-    return removeEpsilon(result_grammar);
+bool operator == (const GreibachRule& rule1, const GreibachRule& rule2) {
+	return rule1.terminal == rule2.terminal && rule1.first == rule2.first &&
+			rule1.second == rule2.second;
+}
+
+// the grammar in Chomsky form over interned symbols, only its productive rules
+class ChomskyGrammar {
+public:
+	explicit ChomskyGrammar(const Grammar& grammar);
+
+	// the rules of a reachable quotient A\B, sorted and without repeats.
+	// A\A derives epsilon too, the epsilon rules are removed by dropping
+	// the quotients X\X from the right sides
+	void expand(int quotient, vector<GreibachRule>& rules) const;
+	// A\B derives a nonempty word
+	bool isUseful(int A, int B) const {
+		return left_corners_[B * nonterminals_number_ + A];
+	}
+	int quotient(int A, int B) const {
+		return A * nonterminals_number_ + B;
+	}
+	string quotientName(int quotient) const;
+
+	SymbolTable symbols;
+	int start;
+	bool has_epsilon = false;
+	vector<int> nonterminals; // symbol ids, by nonterminal number
+	vector<vector<int>> terminals_of; // by nonterminal E: the terminals e of E--->e
+
+private:
+	void addRule_(const Rule& rule, int type);
+
+	int nonterminals_number_ = 0;
+	vector<int> nonterminal_of_; // by symbol id, -1 for terminals
+	vector<pair<int, pair<int, int>>> binary_rules_; // C--->A D as (C, (A, D))
+	// by A: (C, D) of the productive rules C--->A D
+	vector<vector<pair<int, int>>> rules_by_left_;
+	// B * nonterminals_number + A is set if B derives A ... by a nonempty chain of left children
+	vector<bool> left_corners_;
+	// by D: the nonterminals E with terminal rules such that E is D or a left corner of D
+	vector<vector<int>> terminal_corners_;
+};
+
+ChomskyGrammar::ChomskyGrammar(const Grammar& grammar) {
+	auto nonterminal = [&](const string& symbol) {
+		int id = symbols.intern(symbol);
+		if (id >= static_cast<int>(nonterminal_of_.size())) {
+			nonterminal_of_.resize(id + 1, -1);
+		}
+		if (nonterminal_of_[id] == -1 && !symbols.isTerminal(id)) {
+			nonterminal_of_[id] = nonterminals.size();
+			nonterminals.push_back(id);
+			terminals_of.emplace_back();
+		}
+		return nonterminal_of_[id];
+	};
+	start = nonterminal(grammar.starting_symbol);
+	for (const Rule& rule : grammar.rules) {
+		int type = classifyRuleChomskyToGreybuh(rule, grammar.starting_symbol);
+		int from = nonterminal(rule.from);
+		if (type == 0) {
+			has_epsilon = true;
+		} else if (type == 1) {
+			terminals_of[from].push_back(symbols.intern(rule.to[0]));
+		} else {
+			binary_rules_.push_back({from, {nonterminal(rule.to[0]), nonterminal(rule.to[1])}});
+		}
+	}
+	nonterminals_number_ = nonterminals.size();
+
+	// productive nonterminals, the epsilon rule of the starting symbol doesn't count
+	vector<bool> productive(nonterminals_number_, false);
+	for (int E = 0; E < nonterminals_number_; ++E) {
+		productive[E] = !terminals_of[E].empty();
+	}
+	for (bool changed = true; changed;) {
+		changed = false;
+		for (const auto& rule : binary_rules_) {
+			if (!productive[rule.first] && productive[rule.second.first] &&
+					productive[rule.second.second]) {
+				productive[rule.first] = true;
+				changed = true;
+			}
+		}
+	}
+	rules_by_left_.resize(nonterminals_number_);
+	for (const auto& rule : binary_rules_) {
+		if (productive[rule.second.first] && productive[rule.second.second]) {
+			rules_by_left_[rule.second.first].push_back({rule.first, rule.second.second});
+		}
+	}
+
+	// left corners by a search from every nonterminal over the edges C--->A
+	vector<vector<int>> left_children(nonterminals_number_);
+	for (int A = 0; A < nonterminals_number_; ++A) {
+		for (const auto& rule : rules_by_left_[A]) {
+			left_children[rule.first].push_back(A);
+		}
+	}
+	left_corners_.assign(static_cast<size_t>(nonterminals_number_) * nonterminals_number_, false);
+	terminal_corners_.resize(nonterminals_number_);
+	vector<int> corners; // B and its left corners
+	for (int B = 0; B < nonterminals_number_; ++B) {
+		size_t row = static_cast<size_t>(B) * nonterminals_number_;
+		corners.assign(1, B);
+		for (size_t i = 0; i < corners.size(); ++i) {
+			for (int A : left_children[corners[i]]) {
+				if (!left_corners_[row + A]) {
+					left_corners_[row + A] = true;
+					if (A != B) {
+						corners.push_back(A);
+					}
+				}
+			}
+		}
+		sort(corners.begin(), corners.end());
+		for (int E : corners) {
+			if (!terminals_of[E].empty()) {
+				terminal_corners_[B].push_back(E);
+			}
+		}
+	}
+}
+
+void ChomskyGrammar::expand(int quotient, vector<GreibachRule>& rules) const {
+	rules.clear();
+	int A = quotient / nonterminals_number_;
+	int B = quotient % nonterminals_number_;
+	// A\B--->e E\D C\B for C--->A D and E--->e
+	for (const auto& rule : rules_by_left_[A]) {
+		int C = rule.first;
+		int D = rule.second;
+		if (C != B && !isUseful(C, B)) {
+			continue;
+		}
+		int second = isUseful(C, B) ? this->quotient(C, B) : -1;
+		for (int E : terminal_corners_[D]) {
+			int first = isUseful(E, D) ? this->quotient(E, D) : -1;
+			for (int e : terminals_of[E]) {
+				if (first != -1 && second != -1) {
+					rules.push_back(GreibachRule{e, first, second});
+				}
+				if (first != -1 && C == B) {
+					rules.push_back(GreibachRule{e, first, -1});
+				}
+				if (E == D && second != -1) {
+					rules.push_back(GreibachRule{e, -1, second});
+				}
+				if (E == D && C == B) {
+					rules.push_back(GreibachRule{e, -1, -1});
+				}
+			}
+		}
+	}
+	sort(rules.begin(), rules.end());
+	rules.erase(unique(rules.begin(), rules.end()), rules.end());
+}
+
+string ChomskyGrammar::quotientName(int quotient) const {
+	return symbols.name(nonterminals[quotient / nonterminals_number_]) + "\\" +
+			symbols.name(nonterminals[quotient % nonterminals_number_]);
+}
+
+// quotients of a level of the search are expanded by several threads when there are many of them
+const size_t quotients_per_thread = 64;
+
+void expandQuotients(const ChomskyGrammar& grammar, const vector<int>& quotients, size_t begin,
+		size_t end, vector<vector<GreibachRule>>& rules) {
+	for (size_t i = begin; i < end; ++i) {
+		grammar.expand(quotients[i], rules[i]);
+	}
+}
+
+} // namespace
+
+Grammar chomskyToGreybuh(const Grammar& grammar, unsigned threads_number) {
+	if (threads_number == 0) {
+		threads_number = max(thread::hardware_concurrency(), 1u);
+	}
+	ChomskyGrammar chomsky_grammar(grammar);
+	const SymbolTable& symbols = chomsky_grammar.symbols;
+	const string& start_name = grammar.starting_symbol;
+	int start = chomsky_grammar.start;
+
+	Grammar result_grammar;
+	result_grammar.setStartingSymbol(start_name);
+	if (chomsky_grammar.has_epsilon) {
+		result_grammar.addRule({start_name, {"epsilon"}});
+	}
+	// only the quotients reachable from the starting symbol are expanded, level by level,
+	// and only the useful ones are ever referred to
+	vector<bool> reached(chomsky_grammar.nonterminals.size() * chomsky_grammar.nonterminals.size(), false);
+	vector<int> level;
+	auto reach = [&](int quotient) {
+		if (!reached[quotient]) {
+			reached[quotient] = true;
+			level.push_back(quotient);
+		}
+	};
+	// S--->e E\S for E--->e
+	for (int E = 0; E < static_cast<int>(chomsky_grammar.nonterminals.size()); ++E) {
+		for (int e : chomsky_grammar.terminals_of[E]) {
+			if (E == start) {
+				result_grammar.addRule({start_name, {symbols.name(e)}});
+			}
+			if (chomsky_grammar.isUseful(E, start)) {
+				int quotient = chomsky_grammar.quotient(E, start);
+				reach(quotient);
+				result_grammar.addRule({start_name, {symbols.name(e), chomsky_grammar.quotientName(quotient)}});
+			}
+		}
+	}
+
+	vector<int> quotients;
+	vector<vector<GreibachRule>> rules;
+	while (!level.empty()) {
+		quotients.swap(level);
+		level.clear();
+		rules.resize(quotients.size());
+		size_t level_threads_number = max<size_t>(min<size_t>(threads_number,
+				quotients.size() / quotients_per_thread), 1);
+		vector<thread> threads;
+		for (size_t i = 1; i < level_threads_number; ++i) {
+			threads.emplace_back(expandQuotients, std::cref(chomsky_grammar), std::cref(quotients),
+					i * quotients.size() / level_threads_number,
+					(i + 1) * quotients.size() / level_threads_number, std::ref(rules));
+		}
+		expandQuotients(chomsky_grammar, quotients, 0, quotients.size() / level_threads_number, rules);
+		for (auto& worker : threads) {
+			worker.join();
+		}
+
+		for (size_t i = 0; i < quotients.size(); ++i) {
+			string name = chomsky_grammar.quotientName(quotients[i]);
+			for (const GreibachRule& rule : rules[i]) {
+				Rule result_rule{name, {symbols.name(rule.terminal)}};
+				for (int quotient : {rule.first, rule.second}) {
+					if (quotient != -1) {
+						reach(quotient);
+						result_rule.to.push_back(chomsky_grammar.quotientName(quotient));
+					}
+				}
+				result_grammar.addRule(result_rule);
+			}
+		}
+	}
+	return result_grammar;
 }
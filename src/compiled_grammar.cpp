@@ -0,0 +1,434 @@
+#include "compiled_grammar.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+using std::istream;
+using std::ostream;
+using std::runtime_error;
+
+CompiledGrammar::CompiledGrammar(const Grammar& grammar) {
+	if (grammar.starting_symbol.empty()) {
+		throw runtime_error("grammar has no starting symbol");
+	}
+	rule_begin_.push_back(0);
+	for (unsigned rule_number = 0; rule_number < grammar.rules.size(); ++rule_number) {
+		const Rule& rule = grammar.rules[rule_number];
+		rule_from_.push_back(symbols_.intern(rule.from));
+		for (unsigned i = 0; i < rule.to.size(); ++i) {
+			if (rule.to[i] == "epsilon") {
+				// A--->epsilon is how normal form conversions write empty rules
+				continue;
+			}
+			rule_symbols_.push_back(symbols_.intern(rule.to[i]));
+		}
+		rule_begin_.push_back(rule_symbols_.size());
+	}
+
+	// augment the grammar with a start rule whose left side is used nowhere else
+	string start_symbol = "S'";
+	while (symbols_.find(start_symbol) != -1) {
+		start_symbol += "'";
+	}
+	rule_from_.push_back(symbols_.intern(start_symbol));
+	rule_symbols_.push_back(symbols_.intern(grammar.starting_symbol));
+	rule_begin_.push_back(rule_symbols_.size());
+	start_rule_ = rule_from_.size() - 1;
+
+	computeItems_();
+	computeNullable_();
+	computeProductive_();
+	computePredictionClosures_();
+	computeTerminalSymbols_();
+}
+
+void CompiledGrammar::computeTerminalSymbols_() {
+	character_symbols_.assign(256, -1);
+	terminal_symbols_.clear();
+	max_terminal_length_ = 0;
+	for (int symbol = 0; symbol < symbols_.size(); ++symbol) {
+		if (!symbols_.isTerminal(symbol)) {
+			continue;
+		}
+		string text = terminalText(symbols_.name(symbol));
+		if (!terminal_symbols_.insert({text, symbol}).second) {
+			throw runtime_error("terminals " + symbols_.name(terminal_symbols_[text]) + " and " +
+					symbols_.name(symbol) + " match the same text");
+		}
+		if (text.size() == 1) {
+			character_symbols_[static_cast<unsigned char>(text[0])] = symbol;
+		}
+		max_terminal_length_ = std::max<int>(max_terminal_length_, text.size());
+	}
+}
+
+int CompiledGrammar::terminalSymbol(const string& text) const {
+	auto symbol_iterator = terminal_symbols_.find(text);
+	if (symbol_iterator == terminal_symbols_.end()) {
+		return -1;
+	}
+	return symbol_iterator->second;
+}
+
+void CompiledGrammar::computeItems_() {
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		rule_first_item_.push_back(item_rule_.size());
+		for (int position = 0; position <= ruleLength(rule_number); ++position) {
+			item_rule_.push_back(rule_number);
+			item_next_symbol_.push_back(position == ruleLength(rule_number) ? -1 :
+					ruleSymbol(rule_number, position));
+		}
+	}
+}
+
+void CompiledGrammar::computeNullable_() {
+	// a rule derives epsilon when all of its symbols do: count the ones not known
+	// to be nullable yet and propagate every nullable symbol once
+	nullable_.assign(symbols_.size(), false);
+	vector<int> not_nullable_symbols(rule_from_.size());
+	vector<vector<int>> occurrences(symbols_.size());
+	vector<int> queue;
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		not_nullable_symbols[rule_number] = ruleLength(rule_number);
+		for (int i = rule_begin_[rule_number]; i < rule_begin_[rule_number + 1]; ++i) {
+			occurrences[rule_symbols_[i]].push_back(rule_number);
+		}
+		int from = rule_from_[rule_number];
+		if (not_nullable_symbols[rule_number] == 0 && !nullable_[from]) {
+			nullable_[from] = true;
+			queue.push_back(from);
+		}
+	}
+	for (unsigned queue_position = 0; queue_position < queue.size(); ++queue_position) {
+		for (int rule_number : occurrences[queue[queue_position]]) {
+			int from = rule_from_[rule_number];
+			if (--not_nullable_symbols[rule_number] == 0 && !nullable_[from]) {
+				nullable_[from] = true;
+				queue.push_back(from);
+			}
+		}
+	}
+}
+
+void CompiledGrammar::computeProductive_() {
+	// the same propagation as for nullable symbols, but terminals are productive from the start
+	productive_.assign(symbols_.size(), false);
+	vector<int> unproductive_symbols(rule_from_.size(), 0);
+	vector<vector<int>> occurrences(symbols_.size());
+	vector<int> queue;
+	for (int symbol = 0; symbol < symbols_.size(); ++symbol) {
+		if (symbols_.isTerminal(symbol)) {
+			productive_[symbol] = true;
+		}
+	}
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		for (int i = rule_begin_[rule_number]; i < rule_begin_[rule_number + 1]; ++i) {
+			if (!productive_[rule_symbols_[i]]) {
+				++unproductive_symbols[rule_number];
+				occurrences[rule_symbols_[i]].push_back(rule_number);
+			}
+		}
+		int from = rule_from_[rule_number];
+		if (unproductive_symbols[rule_number] == 0 && !productive_[from]) {
+			productive_[from] = true;
+			queue.push_back(from);
+		}
+	}
+	for (unsigned queue_position = 0; queue_position < queue.size(); ++queue_position) {
+		for (int rule_number : occurrences[queue[queue_position]]) {
+			int from = rule_from_[rule_number];
+			if (--unproductive_symbols[rule_number] == 0 && !productive_[from]) {
+				productive_[from] = true;
+				queue.push_back(from);
+			}
+		}
+	}
+}
+
+bool CompiledGrammar::isProductiveRule_(int rule_number) const {
+	for (int i = rule_begin_[rule_number]; i < rule_begin_[rule_number + 1]; ++i) {
+		if (!productive_[rule_symbols_[i]]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void CompiledGrammar::computePredictionClosures_() {
+	// A predicts B if some productive rule A--->X1 ... Xk B ... has nullable X1, ..., Xk
+	vector<vector<int>> rules_by_symbol(symbols_.size());
+	vector<vector<int>> left_corners(symbols_.size());
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		if (!isProductiveRule_(rule_number)) {
+			continue;
+		}
+		int from = rule_from_[rule_number];
+		rules_by_symbol[from].push_back(rule_number);
+		for (int i = rule_begin_[rule_number]; i < rule_begin_[rule_number + 1]; ++i) {
+			int symbol = rule_symbols_[i];
+			if (!symbols_.isTerminal(symbol)) {
+				left_corners[from].push_back(symbol);
+			}
+			if (!nullable_[symbol]) {
+				break;
+			}
+		}
+	}
+
+	prediction_begin_.assign(1, 0);
+	prediction_items_.clear();
+	vector<int> visited(symbols_.size(), -1);
+	vector<int> queue;
+	for (int symbol = 0; symbol < symbols_.size(); ++symbol) {
+		if (!symbols_.isTerminal(symbol)) {
+			queue.assign(1, symbol);
+			visited[symbol] = symbol;
+			for (unsigned queue_position = 0; queue_position < queue.size(); ++queue_position) {
+				int predicted_symbol = queue[queue_position];
+				for (int rule_number : rules_by_symbol[predicted_symbol]) {
+					prediction_items_.push_back(rule_first_item_[rule_number]);
+				}
+				for (int left_corner : left_corners[predicted_symbol]) {
+					if (visited[left_corner] != symbol) {
+						visited[left_corner] = symbol;
+						queue.push_back(left_corner);
+					}
+				}
+			}
+		}
+		prediction_begin_.push_back(prediction_items_.size());
+	}
+}
+
+// The file is a header of uint32 fields followed by the arrays in the order
+// of the header, each of them padded to 4 bytes: symbol names as offsets into
+// a blob of characters, rules, items, nullable and productive symbols as bytes
+// and prediction closures
+static const char format_magic[8] = {'G', 'R', 'A', 'M', 'M', 'A', 'R', 'C'};
+static const uint32_t format_version = 1;
+static const uint32_t byte_order_mark = 0x01020304;
+
+namespace {
+
+struct FileHeader {
+	uint32_t version;
+	uint32_t byte_order_mark;
+	uint32_t symbols_number;
+	uint32_t names_length;
+	uint32_t rules_number;
+	uint32_t rule_symbols_number;
+	uint32_t items_number;
+	uint32_t prediction_items_number;
+	uint32_t start_rule;
+};
+
+class BinaryWriter {
+public:
+	explicit BinaryWriter(ostream& os) : os_(os) {
+	}
+
+	template<typename T>
+	void write(const T* data, size_t size) {
+		os_.write(reinterpret_cast<const char*>(data), size * sizeof(T));
+		static const char padding[4] = {};
+		os_.write(padding, (4 - size * sizeof(T) % 4) % 4);
+	}
+	template<typename T>
+	void write(const vector<T>& v) {
+		write(v.data(), v.size());
+	}
+	void write(const vector<bool>& v) {
+		write(vector<char>(v.begin(), v.end()));
+	}
+
+private:
+	ostream& os_;
+};
+
+// reads the arrays of the file straight into their vectors, checking they are inside of it
+class BinaryReader {
+public:
+	BinaryReader(istream& is, size_t size) : is_(is), size_(size) {
+	}
+
+	template<typename T>
+	void read(T* destination, size_t size) {
+		size_t bytes_number = size * sizeof(T);
+		if (bytes_number / sizeof(T) != size || bytes_number > size_ - offset_) {
+			throw runtime_error("compiled grammar file is truncated");
+		}
+		// the vector of an empty table may have no data at all
+		if (bytes_number == 0) {
+			return;
+		}
+		if (!is_.read(reinterpret_cast<char*>(destination), bytes_number)) {
+			throw runtime_error("can't read compiled grammar file");
+		}
+		offset_ += bytes_number;
+		size_t padding = std::min<size_t>((4 - bytes_number % 4) % 4, size_ - offset_);
+		is_.ignore(padding);
+		offset_ += padding;
+	}
+	template<typename T>
+	void read(vector<T>& v, size_t size) {
+		// the size is checked before the vector is allocated
+		if (size > size_ / sizeof(T)) {
+			throw runtime_error("compiled grammar file is truncated");
+		}
+		v.resize(size);
+		read(v.data(), size);
+	}
+	void read(vector<bool>& v, size_t size) {
+		vector<char> bytes;
+		read(bytes, size);
+		v.assign(bytes.begin(), bytes.end());
+	}
+
+private:
+	istream& is_;
+	size_t size_;
+	size_t offset_ = 0;
+};
+
+}
+
+void CompiledGrammar::save(const string& file_name) const {
+	std::ofstream os(file_name, std::ios::binary);
+	if (!os) {
+		throw runtime_error("can't open " + file_name);
+	}
+	vector<uint32_t> name_ends;
+	string names;
+	for (int symbol = 0; symbol < symbols_.size(); ++symbol) {
+		names += symbols_.name(symbol);
+		name_ends.push_back(names.size());
+	}
+	FileHeader header;
+	header.version = format_version;
+	header.byte_order_mark = byte_order_mark;
+	header.symbols_number = symbols_.size();
+	header.names_length = names.size();
+	header.rules_number = rulesNumber();
+	header.rule_symbols_number = rule_symbols_.size();
+	header.items_number = item_rule_.size();
+	header.prediction_items_number = prediction_items_.size();
+	header.start_rule = start_rule_;
+
+	BinaryWriter writer(os);
+	writer.write(format_magic, sizeof(format_magic));
+	writer.write(&header, 1);
+	writer.write(name_ends);
+	writer.write(names.data(), names.size());
+	writer.write(rule_from_);
+	writer.write(rule_begin_);
+	writer.write(rule_symbols_);
+	writer.write(rule_first_item_);
+	writer.write(item_rule_);
+	writer.write(item_next_symbol_);
+	writer.write(nullable_);
+	writer.write(productive_);
+	writer.write(prediction_begin_);
+	writer.write(prediction_items_);
+	if (!os.flush()) {
+		throw runtime_error("can't write " + file_name);
+	}
+}
+
+CompiledGrammar CompiledGrammar::load(const string& file_name) {
+	std::ifstream is(file_name, std::ios::binary | std::ios::ate);
+	if (!is) {
+		throw runtime_error("can't open " + file_name);
+	}
+	size_t file_size = is.tellg();
+	is.seekg(0);
+	BinaryReader reader(is, file_size);
+	char magic[sizeof(format_magic)];
+	reader.read(magic, sizeof(magic));
+	if (!std::equal(magic, magic + sizeof(magic), format_magic)) {
+		throw runtime_error(file_name + " is not a compiled grammar");
+	}
+	FileHeader header;
+	reader.read(&header, 1);
+	if (header.version != format_version) {
+		throw runtime_error(file_name + " is a compiled grammar of version " +
+				std::to_string(header.version) + ", not " + std::to_string(format_version));
+	}
+	if (header.byte_order_mark != byte_order_mark) {
+		throw runtime_error(file_name + " is compiled for another byte order");
+	}
+
+	CompiledGrammar grammar;
+	uint32_t symbols_number = header.symbols_number;
+	vector<uint32_t> name_ends;
+	reader.read(name_ends, symbols_number);
+	string names(header.names_length, '\0');
+	reader.read(&names[0], names.size());
+	for (uint32_t symbol = 0, name_begin = 0; symbol < symbols_number; ++symbol) {
+		if (name_ends[symbol] < name_begin || name_ends[symbol] > names.size()) {
+			throw runtime_error(file_name + " is corrupted");
+		}
+		grammar.symbols_.intern(names.substr(name_begin, name_ends[symbol] - name_begin));
+		name_begin = name_ends[symbol];
+	}
+	uint32_t rules_number = header.rules_number;
+	reader.read(grammar.rule_from_, rules_number);
+	reader.read(grammar.rule_begin_, rules_number + 1);
+	reader.read(grammar.rule_symbols_, header.rule_symbols_number);
+	reader.read(grammar.rule_first_item_, rules_number);
+	reader.read(grammar.item_rule_, header.items_number);
+	reader.read(grammar.item_next_symbol_, header.items_number);
+	reader.read(grammar.nullable_, symbols_number);
+	reader.read(grammar.productive_, symbols_number);
+	reader.read(grammar.prediction_begin_, symbols_number + 1);
+	reader.read(grammar.prediction_items_, header.prediction_items_number);
+	grammar.start_rule_ = header.start_rule;
+	if (grammar.symbols_.size() != static_cast<int>(symbols_number) ||
+			header.start_rule >= rules_number || !grammar.isConsistent_()) {
+		throw runtime_error(file_name + " is corrupted");
+	}
+	grammar.computeTerminalSymbols_();
+	return grammar;
+}
+
+bool CompiledGrammar::isConsistent_() const {
+	// every index points into its table, so a recognizer can't read out of the tables
+	auto inRange = [](const vector<int>& v, int begin, int end) {
+		return std::all_of(v.begin(), v.end(), [begin, end](int x) { return x >= begin && x < end; });
+	};
+	auto isBoundaries = [](const vector<int>& v, size_t end) {
+		return v.front() == 0 && static_cast<size_t>(v.back()) == end &&
+				std::is_sorted(v.begin(), v.end());
+	};
+	int symbols_number = symbols_.size();
+	int items_number = item_rule_.size();
+	if (!inRange(rule_from_, 0, symbols_number) || !isBoundaries(rule_begin_, rule_symbols_.size()) ||
+			!inRange(rule_symbols_, 0, symbols_number) || !inRange(item_rule_, 0, rulesNumber()) ||
+			!inRange(item_next_symbol_, -1, symbols_number) ||
+			!isBoundaries(prediction_begin_, prediction_items_.size())) {
+		return false;
+	}
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		// the items of a rule are consecutive and the last one is completed
+		uint32_t first_item = rule_first_item_[rule_number];
+		if (first_item >= static_cast<uint32_t>(items_number) ||
+				items_number - first_item <= static_cast<uint32_t>(ruleLength(rule_number)) ||
+				item_next_symbol_[first_item + ruleLength(rule_number)] != -1) {
+			return false;
+		}
+	}
+	for (int item = 0; item < items_number; ++item) {
+		// and every item is one of the items of its rule, so its position in the rule is right
+		int rule_number = item_rule_[item];
+		int first_item = rule_first_item_[rule_number];
+		if (item < first_item || item > first_item + ruleLength(rule_number)) {
+			return false;
+		}
+	}
+	for (uint32_t item : prediction_items_) {
+		if (item >= static_cast<uint32_t>(items_number)) {
+			return false;
+		}
+	}
+	return true;
+}
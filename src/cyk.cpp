@@ -0,0 +1,357 @@
+#include "cyk.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+using std::max;
+using std::min;
+using std::runtime_error;
+using std::thread;
+using std::tuple;
+
+CykGrammar::CykGrammar(const Grammar& grammar) : CykGrammar(CompiledGrammar(grammar)) {
+}
+
+CykGrammar::CykGrammar(const CompiledGrammar& grammar) : grammar_(grammar) {
+	// the augmented start rule of the compiled grammar isn't a part of the grammar
+	int symbols_number = grammar.symbols().size();
+	int augmented_start = grammar.ruleFrom(grammar.startRule());
+	int start_symbol = grammar.ruleSymbol(grammar.startRule(), 0);
+	nonterminal_of_.assign(symbols_number, -1);
+	for (int symbol = 0; symbol < symbols_number; ++symbol) {
+		if (!grammar.isTerminal(symbol) && symbol != augmented_start) {
+			nonterminal_of_[symbol] = nonterminals_number_++;
+		}
+	}
+	start_ = nonterminal_of_[start_symbol];
+	words_number_ = std::max(1, (nonterminals_number_ + 63) / 64);
+	terminal_sets_.assign(static_cast<size_t>(symbols_number) * words_number_, 0);
+
+	vector<tuple<int, int, int>> binary_rules; // A--->B C as (B, C, A)
+	bool start_is_used = false;
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		if (rule_number == grammar.startRule()) {
+			continue;
+		}
+		int from = grammar.ruleFrom(rule_number);
+		int length = grammar.ruleLength(rule_number);
+		if (length == 0 && from == start_symbol) {
+			accepts_empty_ = true;
+			continue;
+		}
+		if (length == 1 && grammar.isTerminal(grammar.ruleSymbol(rule_number, 0))) {
+			int terminal = grammar.ruleSymbol(rule_number, 0);
+			int A = nonterminal_of_[from];
+			terminal_sets_[static_cast<size_t>(terminal) * words_number_ + A / 64] |= uint64_t(1) << (A % 64);
+			continue;
+		}
+		if (length == 2 && !grammar.isTerminal(grammar.ruleSymbol(rule_number, 0)) &&
+				!grammar.isTerminal(grammar.ruleSymbol(rule_number, 1))) {
+			int B = grammar.ruleSymbol(rule_number, 0);
+			int C = grammar.ruleSymbol(rule_number, 1);
+			start_is_used = start_is_used || B == start_symbol || C == start_symbol;
+			binary_rules.emplace_back(nonterminal_of_[B], nonterminal_of_[C], nonterminal_of_[from]);
+			continue;
+		}
+		throw runtime_error("a rule of " + grammar.symbols().name(from) + " isn't in Chomsky form");
+	}
+	if (accepts_empty_ && start_is_used) {
+		throw runtime_error("the starting symbol derives epsilon, so it can't be in right sides");
+	}
+
+	std::sort(binary_rules.begin(), binary_rules.end());
+	size_t set_size = static_cast<size_t>(nonterminals_number_) * words_number_;
+	pairs_begin_.assign(nonterminals_number_ + 1, 0);
+	right_children_.assign(set_size, 0);
+	left_heads_.assign(set_size, 0);
+	left_children_.assign(words_number_, 0);
+	binary_right_children_.assign(words_number_, 0);
+	binary_heads_.assign(words_number_, 0);
+	for (size_t i = 0; i < binary_rules.size(); ++i) {
+		int B, C, A;
+		std::tie(B, C, A) = binary_rules[i];
+		if (i == 0 || std::get<0>(binary_rules[i - 1]) != B || std::get<1>(binary_rules[i - 1]) != C) {
+			++pairs_begin_[B + 1];
+			pair_heads_.resize(pair_heads_.size() + words_number_, 0);
+			right_children_[static_cast<size_t>(B) * words_number_ + C / 64] |= uint64_t(1) << (C % 64);
+		}
+		uint64_t head_bit = uint64_t(1) << (A % 64);
+		pair_heads_[pair_heads_.size() - words_number_ + A / 64] |= head_bit;
+		left_heads_[static_cast<size_t>(B) * words_number_ + A / 64] |= head_bit;
+		left_children_[B / 64] |= uint64_t(1) << (B % 64);
+		binary_right_children_[C / 64] |= uint64_t(1) << (C % 64);
+		binary_heads_[A / 64] |= head_bit;
+	}
+	for (int B = 0; B < nonterminals_number_; ++B) {
+		pairs_begin_[B + 1] += pairs_begin_[B];
+	}
+}
+
+CykAlgorithm::CykAlgorithm(unsigned threads_number) : threads_number_(threads_number) {
+	if (threads_number_ == 0) {
+		threads_number_ = max(thread::hardware_concurrency(), 1u);
+	}
+}
+
+bool CykAlgorithm::isRecognized(const CykGrammar& grammar, const string& s) {
+	vector<int> tokens(s.size());
+	for (size_t i = 0; i < s.size(); ++i) {
+		tokens[i] = grammar.compiledGrammar().characterSymbol(s[i]);
+	}
+	return isRecognized(grammar, tokens);
+}
+
+bool CykAlgorithm::isRecognized(const Grammar& grammar, const string& s) {
+	return isRecognized(CykGrammar(grammar), s);
+}
+
+namespace {
+
+// whether every nonterminal of the set is in the cell
+bool isSubset(const uint64_t* set, const uint64_t* cell, int words_number) {
+	for (int w = 0; w < words_number; ++w) {
+		if ((set[w] & ~cell[w]) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool isEmpty(const uint64_t* cell, int words_number) {
+	for (int w = 0; w < words_number; ++w) {
+		if (cell[w] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+bool CykAlgorithm::isRecognized(const CykGrammar& grammar, const vector<int>& tokens) {
+	if (tokens.empty()) {
+		return grammar.accepts_empty_;
+	}
+	tokens_number_ = tokens.size();
+	nonterminals_number_ = grammar.nonterminals_number_;
+	words_number_ = grammar.words_number_;
+	// positions are 0, ..., n
+	positions_words_number_ = tokens_number_ / 64 + 1;
+	blocks_number_ = tokens_number_ / tile_size + 1;
+	size_t bitsets_size = static_cast<size_t>(tokens_number_ + 1) * positions_words_number_;
+	nonempty_ends_.assign(bitsets_size, 0);
+	nonempty_begins_.assign(bitsets_size, 0);
+	if (tiles_.size() < tileNumber_(0, blocks_number_)) {
+		tiles_.resize(tileNumber_(0, blocks_number_));
+	}
+
+	for (int diagonal = 0; diagonal < blocks_number_; ++diagonal) {
+		int tiles_number = blocks_number_ - diagonal;
+		std::atomic<int> next_tile(0);
+		vector<thread> threads;
+		for (int i = 1; i < min<int>(threads_number_, tiles_number); ++i) {
+			threads.emplace_back(&CykAlgorithm::fillDiagonal_, this, std::cref(grammar), std::cref(tokens),
+					diagonal, std::ref(next_tile));
+		}
+		fillDiagonal_(grammar, tokens, diagonal, next_tile);
+		for (auto& worker : threads) {
+			worker.join();
+		}
+	}
+	int start = grammar.start_;
+	int n = tokens_number_;
+	return ((nonemptyEnds_(0)[n / 64] >> (n % 64)) & 1) && derives_(start, 0, n);
+}
+
+void CykAlgorithm::readCell_(int begin, int end, const uint64_t* mask, uint64_t* cell) const {
+	const uint64_t* rows = tiles_[tileNumber_(begin / tile_size, end / tile_size)].data() + begin % tile_size;
+	int end_bit = end % tile_size;
+	for (int w = 0; w < words_number_; ++w) {
+		uint64_t word = 0;
+		for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+			int A_bit = __builtin_ctzll(bits);
+			word |= ((rows[(w * 64 + A_bit) * tile_size] >> end_bit) & 1) << A_bit;
+		}
+		cell[w] = word;
+	}
+}
+
+void CykAlgorithm::fillDiagonal_(const CykGrammar& grammar, const vector<int>& tokens, int diagonal,
+		std::atomic<int>& next_tile) {
+	vector<uint64_t> scratch((tile_size * tile_size + 4) * words_number_);
+	for (int i = next_tile++; i + diagonal < blocks_number_; i = next_tile++) {
+		fillTile_(grammar, tokens, i, i + diagonal, scratch);
+	}
+}
+
+void CykAlgorithm::fillTile_(const CykGrammar& grammar, const vector<int>& tokens, int begin_block,
+		int end_block, vector<uint64_t>& scratch) {
+	int n = tokens_number_;
+	int words_number = words_number_;
+	int symbols_number = grammar.compiledGrammar().symbols().size();
+	const uint64_t* binary_heads = grammar.binary_heads_.data();
+	// the cells of the tile by begin and by end; the tiles of previous diagonals are read
+	// cell by cell from the stored ones into left and right
+	uint64_t* cells = scratch.data();
+	uint64_t* right_children = cells + tile_size * tile_size * words_number;
+	// left children B which can still add a head to the cell: once every head of the pairs
+	// of B is there, the splits with only such B in the left cell are skipped
+	uint64_t* live = right_children + words_number;
+	uint64_t* left = live + words_number;
+	uint64_t* right = left + words_number;
+	std::fill(cells, cells + tile_size * tile_size * words_number, 0);
+	auto tileCell = [&](int begin, int end) {
+		return cells + ((begin % tile_size) * tile_size + end % tile_size) * words_number;
+	};
+	// adds the heads of the pairs (B, C) with B in left and C in right, returns whether the cell changed
+	auto addHeads = [&](const uint64_t* left, const uint64_t* live_left, const uint64_t* right, uint64_t* cell) {
+		bool is_changed = false;
+		for (int w = 0; w < words_number; ++w) {
+			for (uint64_t bits = left[w] & live_left[w]; bits != 0; bits &= bits - 1) {
+				int B = w * 64 + __builtin_ctzll(bits);
+				// the pairs of B are in the order of C: the pair of C is at its rank
+				const uint64_t* B_right_children = grammar.rightChildren_(B);
+				int pair_number = grammar.pairs_begin_[B];
+				for (int v = 0; v < words_number; ++v) {
+					for (uint64_t common = B_right_children[v] & right[v]; common != 0; common &= common - 1) {
+						uint64_t lower = B_right_children[v] & ((common & -common) - 1);
+						const uint64_t* heads = grammar.heads_(pair_number + __builtin_popcountll(lower));
+						for (int u = 0; u < words_number; ++u) {
+							is_changed = is_changed || (heads[u] & ~cell[u]) != 0;
+							cell[u] |= heads[u];
+						}
+					}
+					pair_number += __builtin_popcountll(B_right_children[v]);
+				}
+			}
+		}
+		return is_changed;
+	};
+
+	int begin_first = begin_block * tile_size;
+	int begin_last = min(begin_first + tile_size, n) - 1;
+	for (int begin = begin_first; begin <= begin_last; ++begin) {
+		// the ends of the row whose cells aren't saturated yet
+		uint64_t open_ends = ~uint64_t(0);
+		for (int k = begin_block + 1; k < end_block && open_ends != 0; ++k) {
+			for (uint64_t splits = nonemptyEnds_(begin)[k]; splits != 0 && open_ends != 0; splits &= splits - 1) {
+				int split = k * tile_size + __builtin_ctzll(splits);
+				uint64_t ends = nonemptyEnds_(split)[end_block] & open_ends;
+				if (ends == 0) {
+					continue;
+				}
+				readCell_(begin, split, grammar.left_children_.data(), left);
+				std::fill(right_children, right_children + words_number, 0);
+				for (int w = 0; w < words_number; ++w) {
+					for (uint64_t bits = left[w]; bits != 0; bits &= bits - 1) {
+						const uint64_t* B_right_children = grammar.rightChildren_(w * 64 + __builtin_ctzll(bits));
+						for (int v = 0; v < words_number; ++v) {
+							right_children[v] |= B_right_children[v];
+						}
+					}
+				}
+				// the right cells with a right child of the left one, a word of ends per child;
+				// ends of empty spans are masked out
+				uint64_t useful_ends = 0;
+				for (int w = 0; w < words_number; ++w) {
+					for (uint64_t bits = right_children[w]; bits != 0; bits &= bits - 1) {
+						useful_ends |= tileRow_(w * 64 + __builtin_ctzll(bits), split, end_block);
+					}
+				}
+				for (ends &= useful_ends; ends != 0; ends &= ends - 1) {
+					int end_bit = __builtin_ctzll(ends);
+					readCell_(split, end_block * tile_size + end_bit, right_children, right);
+					uint64_t* cell = cells + ((begin % tile_size) * tile_size + end_bit) * words_number;
+					if (addHeads(left, grammar.left_children_.data(), right, cell) &&
+							isSubset(binary_heads, cell, words_number)) {
+						open_ends &= ~(uint64_t(1) << end_bit);
+					}
+				}
+			}
+		}
+	}
+
+	int end_first = max(end_block * tile_size, begin_first + 1);
+	int end_last = min(end_block * tile_size + tile_size - 1, n);
+	for (int end = end_first; end <= end_last; ++end) {
+		for (int begin = min(begin_first + tile_size, end) - 1; begin >= begin_first; --begin) {
+			uint64_t* cell = tileCell(begin, end);
+			if (end == begin + 1 && tokens[begin] >= 0 && tokens[begin] < symbols_number) {
+				std::copy(grammar.terminalSet_(tokens[begin]), grammar.terminalSet_(tokens[begin]) + words_number,
+						cell);
+			}
+			std::copy(grammar.left_children_.begin(), grammar.left_children_.end(), live);
+			bool is_saturated = isSubset(binary_heads, cell, words_number);
+			// the cell only grows, so B once dead stays dead; no live B means no other split adds anything
+			auto updateLive = [&]() {
+				is_saturated = true;
+				for (int w = 0; w < words_number; ++w) {
+					for (uint64_t bits = live[w]; bits != 0; bits &= bits - 1) {
+						if (isSubset(grammar.leftHeads_(w * 64 + __builtin_ctzll(bits)), cell, words_number)) {
+							live[w] &= ~(bits & -bits);
+						}
+					}
+					is_saturated = is_saturated && live[w] == 0;
+				}
+			};
+			if (!is_saturated && !isEmpty(cell, words_number)) {
+				updateLive();
+			}
+			// the rest of splits with both cells non-empty are in the blocks of this tile: the left
+			// cells of block j and the right ones of block i are in cells, the others are stored
+			const uint64_t* left_splits = nonemptyEnds_(begin);
+			const uint64_t* right_splits = nonemptyBegins_(end);
+			int blocks[] = {begin_block, end_block};
+			for (int i = 0; i < (begin_block == end_block ? 1 : 2) && !is_saturated; ++i) {
+				int s = blocks[i];
+				for (uint64_t splits = left_splits[s] & right_splits[s]; splits != 0 && !is_saturated;
+						splits &= splits - 1) {
+					int split = s * tile_size + __builtin_ctzll(splits);
+					const uint64_t* split_left = left;
+					if (s == end_block) {
+						split_left = tileCell(begin, split);
+					} else {
+						readCell_(begin, split, live, left);
+					}
+					const uint64_t* split_right = right;
+					if (s == begin_block) {
+						split_right = tileCell(split, end);
+					} else {
+						readCell_(split, end, grammar.binary_right_children_.data(), right);
+					}
+					if (addHeads(split_left, live, split_right, cell)) {
+						updateLive();
+					}
+				}
+			}
+			if (isEmpty(cell, words_number)) {
+				continue;
+			}
+			nonemptyEnds_(begin)[end / 64] |= uint64_t(1) << (end % 64);
+			nonemptyBegins_(end)[begin / 64] |= uint64_t(1) << (begin % 64);
+		}
+	}
+	// the tile is only stored if a span of it is non-empty
+	bool is_empty = true;
+	for (int begin = begin_first; begin <= begin_last && is_empty; ++begin) {
+		is_empty = nonemptyEnds_(begin)[end_block] == 0;
+	}
+	if (is_empty) {
+		return;
+	}
+	vector<uint64_t>& tile = tiles_[tileNumber_(begin_block, end_block)];
+	tile.assign(static_cast<size_t>(nonterminals_number_) * tile_size, 0);
+	for (int begin = begin_first; begin <= begin_last; ++begin) {
+		for (uint64_t ends = nonemptyEnds_(begin)[end_block]; ends != 0; ends &= ends - 1) {
+			int end_bit = __builtin_ctzll(ends);
+			const uint64_t* cell = cells + ((begin % tile_size) * tile_size + end_bit) * words_number;
+			for (int w = 0; w < words_number; ++w) {
+				for (uint64_t bits = cell[w]; bits != 0; bits &= bits - 1) {
+					tile[(w * 64 + __builtin_ctzll(bits)) * tile_size + begin % tile_size] |= uint64_t(1) << end_bit;
+				}
+			}
+		}
+	}
+}
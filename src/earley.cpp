@@ -2,139 +2,442 @@
 #include "earley.h"
 
 #include <vector>
-#include <algorithm>
-#include <unordered_set>
 #include <iostream>
+#include <stdexcept>
 
 using std::cout;
 using std::endl;
+using std::runtime_error;
 using std::vector;
-using std::find;
-using std::unordered_set;
 
-ostream& operator << (ostream& os, const Situation& s) {
-	os << s.rule << ' ' << s.deduced_prefix_length << ' ' << s.position_in_rule;
-	return os;
+void EarleyAlgorithm::initialize_(const CompiledGrammar& grammar) {
+	grammar_ = &grammar;
+	advanceStamps_();
+	D_situations_.clear();
+	tokens_.clear();
+	D_situations_.addColumn();
+	insert_(0, predict_(grammar.startRule(), 0)); // (S'->.S, 0) situation
 }
 
-size_t SituationHash::operator () (const Situation& s) const {
-	size_t hash_1 = std::hash<int>()(s.deduced_prefix_length);
-	size_t hash_2 = std::hash<int>()(s.position_in_rule);
-	return hash_1 ^ (hash_2 << 1);
+void EarleyAlgorithm::advanceStamps_() {
+	column_stamp_base_ += D_situations_.columnsNumber();
+	size_t symbols_number = grammar_->symbols().size();
+	// no chart fits 2^31 columns in memory, so stamps of one recognition never overflow
+	if (predicted_in_column_.size() < symbols_number || column_stamp_base_ > UINT32_MAX / 2) {
+		column_stamp_base_ = 0;
+		predicted_in_column_.assign(symbols_number, 0);
+		scan_column_.assign(symbols_number, 0);
+		scan_head_.resize(symbols_number);
+		scan_tail_.resize(symbols_number);
+	}
 }
 
-bool operator == (const Situation& s1, const Situation& s2) {
-	return s1.rule == s2.rule && s1.deduced_prefix_length == s2.deduced_prefix_length &&
-			s1.position_in_rule == s2.position_in_rule;
+int EarleyAlgorithm::positionInRule_(const Situation& situation) const {
+	return situation.item - grammar_->ruleFirstItem(grammar_->itemRule(situation.item));
 }
 
-void EarleyAlgorithm::initialize_(const Grammar& grammar, const string& s) {
-	D_situations_ = vector<unordered_set<Situation, SituationHash>>(s.size() + 1);
-	Rule basic_rule = {"S'", {"S"}}; // (S'->.S, 0) situation
-	D_situations_[0].insert({basic_rule, 0, 0});
+bool EarleyAlgorithm::insert_(int d_number, const Situation& situation, uint32_t predecessor) {
+	int next_symbol = nextSymbol_(situation);
+	bool waits_for_terminal = next_symbol != -1 && grammar_->isTerminal(next_symbol);
+	if (!D_situations_.insert(situation, waits_for_terminal ? -1 : next_symbol)) {
+		if (building_forest_ && predecessor != Chart::npos) {
+			// one more derivation of a known situation; every predecessor is
+			// linked once, since every waiting chain is completed once per column
+			D_situations_.addLink(D_situations_.find(situation), predecessor);
+		}
+		return false;
+	}
+	if (building_forest_ && predecessor != Chart::npos) {
+		D_situations_.addLink(D_situations_.columnEnd(d_number) - 1, predecessor);
+	}
+	if (waits_for_terminal) {
+		chainScan_(d_number, next_symbol, D_situations_.columnEnd(d_number) - 1);
+	}
+	return true;
 }
 
-Situation EarleyAlgorithm::predict_(const Rule& rule, int d_number) {
-	return Situation(rule, d_number, 0);
+void EarleyAlgorithm::chainScan_(int d_number, int terminal, uint32_t position) {
+	if (scan_column_[terminal] != columnStamp_(d_number)) {
+		scan_column_[terminal] = columnStamp_(d_number);
+		scan_head_[terminal] = position;
+	} else {
+		D_situations_.link(scan_tail_[terminal], position);
+	}
+	scan_tail_[terminal] = position;
 }
 
-bool EarleyAlgorithm::predict_(int d_number, const Grammar& grammar, const string& s) {
-	// return true if a new situation appeared
-	bool new_situation_appeared = false;
-	for (const auto& situation : D_situations_[d_number]) {
-		if (situation.position_in_rule >= static_cast<int>(situation.rule.to.size())) {
-			continue;
+void EarleyAlgorithm::rechainScans_(int d_number) {
+	uint32_t column_end = D_situations_.columnEnd(d_number);
+	// 0 is never a stamp, so the chains start anew even if the column already has them
+	for (uint32_t k = D_situations_.columnBegin(d_number); k < column_end; ++k) {
+		int next_symbol = grammar_->itemNextSymbol(D_situations_.item(k));
+		if (next_symbol != -1 && grammar_->isTerminal(next_symbol)) {
+			scan_column_[next_symbol] = 0;
+			D_situations_.link(k, Chart::npos);
 		}
-		string next_symbol = situation.rule.to[situation.position_in_rule];
-		if (!isAlphabetSymbol(next_symbol)) {
-			for (unsigned rule_number = 0; rule_number < grammar.rules.size(); ++rule_number) {
-				if (grammar.rules[rule_number].from == next_symbol) {
-					Situation new_situation = predict_(grammar.rules[rule_number], d_number);
-					auto insert_result = D_situations_[d_number].insert(new_situation);
-					new_situation_appeared |= insert_result.second;
-				}
-			}
+	}
+	for (uint32_t k = D_situations_.columnBegin(d_number); k < column_end; ++k) {
+		int next_symbol = grammar_->itemNextSymbol(D_situations_.item(k));
+		if (next_symbol != -1 && grammar_->isTerminal(next_symbol)) {
+			chainScan_(d_number, next_symbol, k);
 		}
 	}
-	return new_situation_appeared;
+}
+
+Situation EarleyAlgorithm::predict_(int rule_number, int d_number) {
+	return Situation{grammar_->ruleFirstItem(rule_number), static_cast<uint32_t>(d_number)};
+}
+
+void EarleyAlgorithm::predict_(int d_number, uint32_t position) {
+	Situation situation = D_situations_[position];
+	int next_symbol = nextSymbol_(situation);
+	if (grammar_->isNullable(next_symbol)) {
+		// Aycock-Horspool: step over a nullable symbol right away instead of
+		// waiting for its empty completion
+		insert_(d_number, complete_(situation), position);
+	}
+	if (predicted_in_column_[next_symbol] == columnStamp_(d_number)) {
+		return;
+	}
+	// the closure already contains everything the predicted situations would predict
+	predicted_in_column_[next_symbol] = columnStamp_(d_number);
+	const uint32_t* prediction_end = grammar_->predictionEnd(next_symbol);
+	for (const uint32_t* item = grammar_->predictionBegin(next_symbol); item != prediction_end;
+			++item) {
+		insert_(d_number, Situation{*item, static_cast<uint32_t>(d_number)});
+	}
 }
 
 Situation EarleyAlgorithm::complete_(const Situation& situation_k) {
-	return Situation(situation_k.rule, situation_k.deduced_prefix_length,
-			situation_k.position_in_rule + 1);
+	return Situation{situation_k.item + 1, situation_k.deduced_prefix_length};
 }
 
-bool EarleyAlgorithm::complete_(int d_number, const string& s) {
-	// return true if new situation appeared
-	bool new_situation_appeared = false;
-	for (const auto& situation_j : D_situations_[d_number]) {
-		if (situation_j.position_in_rule != static_cast<int>(situation_j.rule.to.size())) {
-			continue;
+void EarleyAlgorithm::complete_(int d_number, const Situation& situation_j) {
+	if (static_cast<int>(situation_j.deduced_prefix_length) == d_number) {
+		// an empty derivation, predict_ has already stepped over its symbol
+		return;
+	}
+	int completed_symbol = grammar_->ruleFrom(grammar_->itemRule(situation_j.item));
+	// other rules of the symbol may have completed it from the same column already
+	uint32_t first_waiting = D_situations_.firstWaitingOnce(situation_j.deduced_prefix_length,
+			completed_symbol);
+	if (first_waiting == Chart::npos) {
+		return;
+	}
+	Situation top;
+	// the situations Leo's optimization skips are the ones parse forests are made of
+	if (!building_forest_ &&
+			transitiveSituation_(situation_j.deduced_prefix_length, completed_symbol, top)) {
+		insert_(d_number, top);
+		return;
+	}
+	for (uint32_t k = first_waiting; k != Chart::npos; k = D_situations_.nextWaiting(k)) {
+		insert_(d_number, complete_(D_situations_[k]), k);
+	}
+}
+
+bool EarleyAlgorithm::transitiveSituation_(int d_number, int symbol, Situation& top) {
+	// Leo: while the only situation waiting for the completed symbol is B--->beta . symbol,
+	// completing the symbol completes B at the origin of that situation, and so on.
+	// Only the topmost situation of this path is put into the chart, it is memoized
+	// for every (column, symbol) on the path, so right recursion costs O(1) per column
+	leo_path_.clear();
+	uint64_t top_key = Chart::no_transitive;
+	uint64_t last_completed = Chart::no_transitive;
+	while (true) {
+		uint64_t memo = D_situations_.transitive(d_number, symbol);
+		if (memo != Chart::unknown_transitive) {
+			// no_transitive here is also how a cycle through the path itself ends
+			top_key = memo;
+			break;
 		}
-		for (const auto& situation_k : D_situations_[situation_j.deduced_prefix_length]) {
-			if (situation_k.position_in_rule == static_cast<int>(situation_k.rule.to.size())) {
-				continue;
-			}
-			if (situation_k.rule.to[situation_k.position_in_rule] != situation_j.rule.from) {
-				continue;
-			}
-			Situation new_situation = complete_(situation_k);
-			auto insert_result = D_situations_[d_number].insert(new_situation);
-			new_situation_appeared |= insert_result.second;
+		uint32_t k = D_situations_.firstWaiting(d_number, symbol);
+		Situation waiting = D_situations_[k];
+		D_situations_.setTransitive(d_number, symbol, Chart::no_transitive);
+		if (D_situations_.nextWaiting(k) != Chart::npos ||
+				grammar_->itemNextSymbol(waiting.item + 1) != -1) {
+			break;
+		}
+		leo_path_.push_back({d_number, symbol});
+		last_completed = packSituation(complete_(waiting));
+		symbol = grammar_->ruleFrom(grammar_->itemRule(waiting.item));
+		if (symbol == grammar_->ruleFrom(grammar_->startRule())) {
+			// (S'->S., 0) has to stay in the chart
+			break;
+		}
+		d_number = waiting.deduced_prefix_length;
+	}
+	if (top_key == Chart::no_transitive) {
+		if (leo_path_.empty()) {
+			return false;
+		}
+		top_key = last_completed;
+	}
+	for (const auto& path_step : leo_path_) {
+		D_situations_.setTransitive(path_step.first, path_step.second, top_key);
+	}
+	top = unpackSituation(top_key);
+	return true;
+}
+
+void EarleyAlgorithm::processColumn_(int d_number) {
+	// every situation is handled exactly once, situations it adds are handled after it;
+	// the column is the last one, so its end moves while it is processed
+	for (uint32_t k = D_situations_.columnBegin(d_number); k < D_situations_.columnEnd(d_number);
+			++k) {
+		int next_symbol = grammar_->itemNextSymbol(D_situations_.item(k));
+		if (next_symbol == -1) {
+			complete_(d_number, D_situations_[k]);
+		} else if (!grammar_->isTerminal(next_symbol)) {
+			predict_(d_number, k);
 		}
 	}
-	return new_situation_appeared;
 }
 
 Situation EarleyAlgorithm::scan_(Situation situation) {
-	++situation.position_in_rule;
+	++situation.item;
 	return situation;
 }
 
-void EarleyAlgorithm::scan_(int d_number, const string& s) {
-	for (const auto& situation : D_situations_[d_number]) {
-		if (situation.position_in_rule < static_cast<int>(situation.rule.to.size()) &&
-				isAlphabetSymbol(situation.rule.to[situation.position_in_rule])) {
-			string current_character;
-			current_character += s[d_number];
-			if (current_character != situation.rule.to[situation.position_in_rule]) {
-				continue;
-			}
-			Situation new_situation = scan_(situation);
-			D_situations_[d_number + 1].insert(new_situation);
-		}
+void EarleyAlgorithm::scan_(int d_number, int terminal) {
+	D_situations_.addColumn();
+	// only terminals have scan chains, anything else is scanned into an empty column
+	if (terminal < 0 || terminal >= grammar_->symbols().size() ||
+			scan_column_[terminal] != columnStamp_(d_number)) {
+		return;
+	}
+	for (uint32_t k = scan_head_[terminal]; k != Chart::npos;
+			k = D_situations_.nextWaiting(k)) {
+		insert_(d_number + 1, scan_(D_situations_[k]), k);
 	}
 }
 
 void EarleyAlgorithm::finalize_() {
+	column_stamp_base_ += D_situations_.columnsNumber();
 	D_situations_.clear();
 }
 
-bool EarleyAlgorithm::isRecognized(const Grammar& grammar, const string& s) {
-	// we expect grammar to have a S' starting symbol and S'->S basic rule
-	initialize_(grammar, s);
+void EarleyAlgorithm::print(ostream& os, const Situation& situation) const {
+	int rule_number = grammar_->itemRule(situation.item);
+	const SymbolTable& symbols = grammar_->symbols();
+	os << symbols.name(grammar_->ruleFrom(rule_number)) << "--->";
+	for (int i = 0; i < grammar_->ruleLength(rule_number); ++i) {
+		if (i != 0) {
+			os << ' ';
+		}
+		os << symbols.name(grammar_->ruleSymbol(rule_number, i));
+	}
+	os << ' ' << situation.deduced_prefix_length << ' ' << positionInRule_(situation);
+}
 
-	bool something_changed = true;
-	while(something_changed) {
-		something_changed = false;
-		something_changed |= predict_(0, grammar, s);
-		something_changed |= complete_(0, s);
+void EarleyAlgorithm::print(int d_number) {
+	for (uint32_t k = D_situations_.columnBegin(d_number); k < D_situations_.columnEnd(d_number);
+			++k) {
+		print(cout, D_situations_[k]);
+		cout << endl;
 	}
+}
 
-	for (unsigned i = 1; i <= s.size(); ++i) {
-		scan_(i - 1, s);
-		bool something_changed = true;
-		while(something_changed) {
-			something_changed = false;
-			something_changed |= predict_(i, grammar, s);
-			something_changed |= complete_(i, s);
-		}
+ParseForest EarleyAlgorithm::parseForest() const {
+	if (!building_forest_) {
+		throw runtime_error("the recognition wasn't reset for building a parse forest");
 	}
+	return ParseForest(*grammar_, D_situations_);
+}
+
+bool EarleyAlgorithm::isRecognized(const CompiledGrammar& grammar, const string& s) {
+	reset(grammar);
+	feed(s);
+	bool answer = accepts();
+	finalize_();
+	return answer;
+}
+
+bool EarleyAlgorithm::isRecognized(const Grammar& grammar, const string& s) {
+	return isRecognized(CompiledGrammar(grammar), s);
+}
 
-	Rule desired_rule = {"S'", {"S"}};
-	Situation desired_situation(desired_rule, 0, 1); // (S'->S., 0) situation
-	bool answer = std::find(D_situations_[s.size()].begin(), D_situations_[s.size()].end(),
-			desired_situation) != D_situations_[s.size()].end();
+bool EarleyAlgorithm::isRecognized(const CompiledGrammar& grammar, const vector<int>& tokens) {
+	reset(grammar);
+	feed(tokens);
+	bool answer = accepts();
 	finalize_();
 	return answer;
 }
+
+void EarleyAlgorithm::reset(const CompiledGrammar& grammar, bool building_forest) {
+	building_forest_ = building_forest;
+	initialize_(grammar);
+	processColumn_(0);
+}
+
+bool EarleyAlgorithm::feedToken(int terminal) {
+	int d_number = D_situations_.columnsNumber() - 1;
+	tokens_.push_back(terminal);
+	scan_(d_number, terminal);
+	processColumn_(d_number + 1);
+	return isViablePrefix();
+}
+
+bool EarleyAlgorithm::feed(const vector<int>& tokens) {
+	for (int terminal : tokens) {
+		feedToken(terminal);
+	}
+	return isViablePrefix();
+}
+
+bool EarleyAlgorithm::feed(char c) {
+	return feedToken(grammar_->characterSymbol(c));
+}
+
+bool EarleyAlgorithm::feed(const string& s) {
+	for (char c : s) {
+		feedToken(grammar_->characterSymbol(c));
+	}
+	return isViablePrefix();
+}
+
+bool EarleyAlgorithm::isViablePrefix() const {
+	// only productive rules are predicted, so every situation of the last column
+	// continues to a derivation, unless the start rule itself is unproductive
+	return grammar_->isProductive(grammar_->ruleFrom(grammar_->startRule())) &&
+			D_situations_.columnSize(D_situations_.columnsNumber() - 1) != 0;
+}
+
+vector<string> EarleyAlgorithm::expectedTerminals() const {
+	vector<string> terminals;
+	if (!isViablePrefix()) {
+		return terminals;
+	}
+	// the terminals which some situation of the last column waits for have scan chains there
+	uint32_t stamp = columnStamp_(D_situations_.columnsNumber() - 1);
+	const SymbolTable& symbols = grammar_->symbols();
+	for (int symbol = 0; symbol < symbols.size(); ++symbol) {
+		if (symbols.isTerminal(symbol) && scan_column_[symbol] == stamp) {
+			terminals.push_back(symbols.name(symbol));
+		}
+	}
+	return terminals;
+}
+
+bool EarleyAlgorithm::accepts() const {
+	// (S'->S., 0) situation
+	return D_situations_.contains(Situation{grammar_->ruleFirstItem(grammar_->startRule()) + 1, 0});
+}
+
+vector<Situation> EarleyAlgorithm::columnSituations(int d_number) const {
+	vector<Situation> situations;
+	for (uint32_t k = D_situations_.columnBegin(d_number); k < D_situations_.columnEnd(d_number); ++k) {
+		situations.push_back(D_situations_[k]);
+	}
+	return situations;
+}
+
+bool EarleyAlgorithm::matchesOldColumn_(int d_number, uint32_t old_begin, uint32_t old_end,
+		int old_d_number, int position, int shift) const {
+	// origins up to the edit position are the same in both charts, a later origin o
+	// of the old chart corresponds to o + shift, and the column's own number to d_number.
+	// The rebuilt column is the last one, so it can be searched
+	if (D_situations_.columnSize(d_number) != old_end - old_begin) {
+		return false;
+	}
+	for (uint32_t k = old_begin; k < old_end; ++k) {
+		Situation situation = D_situations_[k];
+		int origin = situation.deduced_prefix_length;
+		if (origin == old_d_number) {
+			situation.deduced_prefix_length = d_number;
+		} else if (origin > position) {
+			if (origin + shift <= position) {
+				return false;
+			}
+			situation.deduced_prefix_length = origin + shift;
+		}
+		if (!D_situations_.contains(situation)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool EarleyAlgorithm::reachesOnlySafeColumns_(int d_number, int position,
+		bool waiting_for_nonterminals) const {
+	for (uint32_t k = D_situations_.columnBegin(d_number); k < D_situations_.columnEnd(d_number);
+			++k) {
+		int next_symbol = grammar_->itemNextSymbol(D_situations_.item(k));
+		int origin = D_situations_.origin(k);
+		if (next_symbol == -1 || origin <= position || origin == d_number ||
+				(waiting_for_nonterminals && grammar_->isTerminal(next_symbol))) {
+			continue;
+		}
+		if (!rebuilt_safe_[origin - position - 1]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool EarleyAlgorithm::edit(size_t position, size_t erased_length, const string& text) {
+	vector<int> tokens;
+	for (char c : text) {
+		tokens.push_back(grammar_->characterSymbol(c));
+	}
+	return edit(position, erased_length, tokens);
+}
+
+bool EarleyAlgorithm::edit(size_t position, size_t erased_length, const vector<int>& tokens) {
+	if (building_forest_) {
+		throw runtime_error("inputs of parse forests can't be edited");
+	}
+	if (position + erased_length > tokens_.size()) {
+		throw runtime_error("edit range is out of the input");
+	}
+	if (erased_length == 0 && tokens.empty()) {
+		return isViablePrefix();
+	}
+	vector<int> suffix(tokens_.begin() + position + erased_length, tokens_.end());
+	int old_last_column = tokens_.size();
+	// the stamps of the rebuilt columns were used by the old ones
+	advanceStamps_();
+	// old column j > position becomes detached column j - position - 1,
+	// columns up to the edit position stay where they are
+	D_situations_.detach(position + 1);
+	tokens_.resize(position);
+	rechainScans_(position);
+
+	// A rebuilt column is safe if it matches its old column and so do, recursively,
+	// the columns its situations waiting for nonterminals start at: completions
+	// can't reach anything else from it. Once the situations of a matching column
+	// which aren't completed only start at safe columns, every following column
+	// would be rebuilt as the old one, so the rest of the old chart is reattached
+	int shift = static_cast<int>(tokens.size()) - static_cast<int>(erased_length);
+	vector<int> rebuilt_input = tokens;
+	rebuilt_input.insert(rebuilt_input.end(), suffix.begin(), suffix.end());
+	int first_reattached = old_last_column - position;
+	rebuilt_safe_.clear();
+	for (unsigned i = 0; i < rebuilt_input.size(); ++i) {
+		feedToken(rebuilt_input[i]);
+		int d_number = D_situations_.columnsNumber() - 1;
+		int old_d_number = d_number - shift;
+		bool matches = false;
+		if (old_d_number == static_cast<int>(position) && erased_length == 0) {
+			matches = matchesOldColumn_(d_number, D_situations_.columnBegin(position),
+					D_situations_.columnEnd(position), old_d_number, position, shift);
+		} else if (old_d_number >= static_cast<int>(position + erased_length)) {
+			int j = old_d_number - position - 1;
+			matches = matchesOldColumn_(d_number, D_situations_.detachedBegin(j),
+					D_situations_.detachedEnd(j), old_d_number, position, shift);
+		}
+		rebuilt_safe_.push_back(matches && reachesOnlySafeColumns_(d_number, position, true));
+		if (matches && old_d_number < old_last_column &&
+				reachesOnlySafeColumns_(d_number, position, false)) {
+			tokens_.insert(tokens_.end(), suffix.begin() + (old_d_number - position - erased_length),
+					suffix.end());
+			first_reattached = old_d_number - position;
+			break;
+		}
+	}
+	D_situations_.reattach(first_reattached, position, shift);
+	// only the last column is scanned by the next feed
+	rechainScans_(D_situations_.columnsNumber() - 1);
+	return isViablePrefix();
+}
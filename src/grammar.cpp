@@ -23,13 +23,30 @@ const unordered_set<string> special_alphabet_symbols = {
 
 bool isAlphabetSymbol(const string& symbol) {
     return (symbol.size() == 1 && symbol[0] >= 'a' && symbol[0] <= 'z') ||
-    		special_alphabet_symbols.find(symbol) != special_alphabet_symbols.end();
+    		special_alphabet_symbols.find(symbol) != special_alphabet_symbols.end() ||
+    		(symbol.size() > 2 && symbol.front() == '"' && symbol.back() == '"');
+}
+
+string terminalText(const string& symbol) {
+    if (symbol.size() > 2 && symbol.front() == '"' && symbol.back() == '"') {
+        return symbol.substr(1, symbol.size() - 2);
+    }
+    return symbol;
 }
 
 bool operator == (const Rule& rule1, const Rule& rule2) {
     return rule1.from == rule2.from && rule1.to == rule2.to;
 }
 
+size_t RuleHash::operator () (const Rule& rule) const {
+    std::hash<string> string_hash;
+    size_t hash = string_hash(rule.from);
+    for (const string& symbol : rule.to) {
+        hash = hash * 1000003 ^ string_hash(symbol);
+    }
+    return hash ^ rule.to.size();
+}
+
 istream& operator >> (istream& is, Rule& rule) {
     is >> rule.from;
     int symbols_number;
@@ -72,13 +89,13 @@ void Grammar::addSymbol(const string& symbol) {
     if (isAlphabetSymbol(symbol)) {
         return;
     }
-    if (find(symbols.begin(), symbols.end(), symbol) == symbols.end()) {
+    if (symbol_set_.insert(symbol).second) {
         symbols.push_back(symbol);
     }
 }
 
 void Grammar::addRule(const Rule& rule) {
-    if (find(rules.begin(), rules.end(), rule) == rules.end()) {
+    if (rule_set_.insert(rule).second) {
         rules.push_back(rule);
         addSymbol(rule.from);
         for (unsigned i = 0; i < rule.to.size(); ++i) {
@@ -88,16 +105,18 @@ void Grammar::addRule(const Rule& rule) {
 }
 
 void Grammar::removeRule(const Rule& rule) {
-    vector<Rule>::iterator rule_iterator = find(
-            rules.begin(), rules.end(), rule);
-    if (rule_iterator == rules.end()) {
+    if (rule_set_.erase(rule) == 0) {
         throw runtime_error("trying to remove non-existing rule");
     }
-    rules.erase(rule_iterator);
+    rules.erase(find(rules.begin(), rules.end(), rule));
 }
 
 bool Grammar::containsRule(const Rule& rule) const {
-    return find(rules.begin(), rules.end(), rule) != rules.end();
+    return rule_set_.find(rule) != rule_set_.end();
+}
+
+bool Grammar::containsSymbol(const string& symbol) const {
+    return symbol_set_.find(symbol) != symbol_set_.end();
 }
 
 bool operator == (const Grammar& grammar1, const Grammar& grammar2) {
@@ -107,10 +126,9 @@ bool operator == (const Grammar& grammar1, const Grammar& grammar2) {
 	if (grammar1.rules.size() != grammar2.rules.size()) {
 		return false;
 	}
+	// rules of a grammar are distinct, so the same number of them and inclusion is enough
 	for (unsigned rule_number = 0; rule_number < grammar1.rules.size(); ++rule_number) {
-		Rule rule = grammar1.rules[rule_number];
-		if (find(grammar2.rules.begin(), grammar2.rules.end(), rule) ==
-				grammar2.rules.end()) {
+		if (!grammar2.containsRule(grammar1.rules[rule_number])) {
 			return false;
 		}
 	}
@@ -0,0 +1,81 @@
+#include "item_set.h"
+
+uint64_t mixKey(uint64_t key) {
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return key;
+}
+
+pair<uint32_t, bool> ItemSet::insert(uint64_t key) {
+	// keep the load factor below 1/2
+	if (2 * (keys_.size() + 1) > slots_.size()) {
+		grow_();
+	}
+	size_t mask = slots_.size() - 1;
+	for (size_t slot = mixKey(key) & mask; ; slot = (slot + 1) & mask) {
+		if (slots_[slot] == 0) {
+			keys_.push_back(key);
+			slots_[slot] = keys_.size();
+			return {keys_.size() - 1, true};
+		}
+		if (keys_[slots_[slot] - 1] == key) {
+			return {slots_[slot] - 1, false};
+		}
+	}
+}
+
+uint32_t ItemSet::find(uint64_t key) const {
+	if (slots_.empty()) {
+		return npos;
+	}
+	size_t mask = slots_.size() - 1;
+	for (size_t slot = mixKey(key) & mask; slots_[slot] != 0; slot = (slot + 1) & mask) {
+		if (keys_[slots_[slot] - 1] == key) {
+			return slots_[slot] - 1;
+		}
+	}
+	return npos;
+}
+
+bool ItemSet::contains(uint64_t key) const {
+	return find(key) != npos;
+}
+
+void ItemSet::clear() {
+	if (8 * keys_.size() < slots_.size()) {
+		// a table grown by a big set once shouldn't cost its whole size on every clear
+		truncate(0);
+	} else {
+		slots_.assign(slots_.size(), 0);
+		keys_.clear();
+	}
+}
+
+void ItemSet::truncate(uint32_t size) {
+	// probe paths of a key only go through slots of the keys inserted before it,
+	// so emptying slots from the last key to the first never breaks a lookup
+	size_t mask = slots_.size() - 1;
+	for (uint32_t position = keys_.size(); position-- > size; ) {
+		size_t slot = mixKey(keys_[position]) & mask;
+		while (slots_[slot] != position + 1) {
+			slot = (slot + 1) & mask;
+		}
+		slots_[slot] = 0;
+	}
+	keys_.resize(size);
+}
+
+void ItemSet::grow_() {
+	slots_.assign(slots_.empty() ? 16 : 2 * slots_.size(), 0);
+	size_t mask = slots_.size() - 1;
+	for (uint32_t position = 0; position < keys_.size(); ++position) {
+		size_t slot = mixKey(keys_[position]) & mask;
+		while (slots_[slot] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		slots_[slot] = position + 1;
+	}
+}
@@ -0,0 +1,62 @@
+#include "lexer.h"
+
+#include <algorithm>
+#include <cctype>
+
+static bool isSpace(char c) {
+	return std::isspace(static_cast<unsigned char>(c));
+}
+
+void CharacterLexer::tokenize(const CompiledGrammar& grammar, const string& text,
+		vector<int>& tokens) const {
+	tokens.clear();
+	for (char c : text) {
+		tokens.push_back(grammar.characterSymbol(c));
+	}
+}
+
+void WhitespaceLexer::tokenize(const CompiledGrammar& grammar, const string& text,
+		vector<int>& tokens) const {
+	tokens.clear();
+	string token;
+	for (size_t i = 0; i < text.size();) {
+		if (isSpace(text[i])) {
+			++i;
+			continue;
+		}
+		size_t token_end = i;
+		while (token_end < text.size() && !isSpace(text[token_end])) {
+			++token_end;
+		}
+		token.assign(text, i, token_end - i);
+		tokens.push_back(grammar.terminalSymbol(token));
+		i = token_end;
+	}
+}
+
+void LongestMatchLexer::tokenize(const CompiledGrammar& grammar, const string& text,
+		vector<int>& tokens) const {
+	tokens.clear();
+	string token;
+	for (size_t i = 0; i < text.size();) {
+		if (isSpace(text[i])) {
+			++i;
+			continue;
+		}
+		size_t length = std::min<size_t>(grammar.maxTerminalLength(), text.size() - i);
+		int symbol = -1;
+		for (; length > 1; --length) {
+			token.assign(text, i, length);
+			symbol = grammar.terminalSymbol(token);
+			if (symbol != -1) {
+				break;
+			}
+		}
+		if (symbol == -1) {
+			length = 1;
+			symbol = grammar.characterSymbol(text[i]);
+		}
+		tokens.push_back(symbol);
+		i += length;
+	}
+}
@@ -1,10 +1,19 @@
 #include "earley.h"
+#include "batch.h"
 
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <string>
 
 using std::cin;
 using std::cout;
+using std::cerr;
 using std::endl;
+using std::ifstream;
+using std::numeric_limits;
+using std::streamsize;
+using std::string;
 
 void checkRecognition() {
 	Grammar grammar;
@@ -16,9 +25,134 @@ void checkRecognition() {
 	cout << EarleyAlgorithm().isRecognized(grammar, s) << endl;
 }
 
-int main() {
-	checkRecognition();
-    return 0;
+// reads a text grammar from the file or, if there is no file, from stdin
+CompiledGrammar readGrammar(const string& grammar_file) {
+	Grammar grammar;
+	if (grammar_file.empty()) {
+		cin >> grammar;
+		cin.ignore(numeric_limits<streamsize>::max(), '\n');
+	} else {
+		ifstream grammar_stream(grammar_file);
+		if (!grammar_stream) {
+			throw runtime_error("can't open " + grammar_file);
+		}
+		grammar_stream >> grammar;
+	}
+	return CompiledGrammar(grammar);
+}
+
+int recognizeBatch(const string& grammar_file, const string& compiled_grammar_file,
+		const string& input_file, unsigned threads_number, const Lexer* lexer) {
+	std::ios::sync_with_stdio(false);
+	cin.tie(nullptr);
+
+	CompiledGrammar compiled_grammar = compiled_grammar_file.empty() ?
+			readGrammar(grammar_file) : CompiledGrammar::load(compiled_grammar_file);
+
+	if (input_file.empty()) {
+		recognizeLines(compiled_grammar, cin, cout, threads_number, lexer);
+	} else {
+		ifstream input_stream(input_file);
+		if (!input_stream) {
+			cerr << "can't open " << input_file << endl;
+			return 1;
+		}
+		recognizeLines(compiled_grammar, input_stream, cout, threads_number, lexer);
+	}
+	return 0;
+}
+
+int compileGrammar(const string& grammar_file, const string& output_file) {
+	readGrammar(grammar_file).save(output_file);
+	return 0;
+}
+
+void printUsage() {
+	cerr << "usage:\n"
+			"  main - read a grammar and one string, print 1 if the string is recognized\n"
+			"  main --batch [--grammar <file>] [--threads <n>] [--lexer <lexer>] [<inputs file>]\n"
+			"    - read a grammar (from stdin unless --grammar is given), then one string per line,\n"
+			"    print 1 or 0 per line; --threads 0 uses every hardware thread, the default is 1;\n"
+			"    the lexer is characters (the default), words or longest;\n"
+			"    --compiled <file> reads a grammar written by --compile instead\n"
+			"  main --compile [--grammar <file>] <output file> - write the compiled grammar\n"
+			"    in the binary format"
+			<< endl;
+}
+
+int main(int argc, char** argv) {
+	if (argc == 1) {
+		checkRecognition();
+		return 0;
+	}
+
+	bool batch = false;
+	bool compile = false;
+	string grammar_file;
+	string compiled_grammar_file;
+	string input_file;
+	unsigned threads_number = 1;
+	WhitespaceLexer whitespace_lexer;
+	LongestMatchLexer longest_match_lexer;
+	const Lexer* lexer = nullptr;
+	for (int i = 1; i < argc; ++i) {
+		string argument = argv[i];
+		if (argument == "--batch") {
+			batch = true;
+		} else if (argument == "--compile") {
+			compile = true;
+		} else if (argument == "--grammar" && i + 1 < argc) {
+			grammar_file = argv[++i];
+		} else if (argument == "--compiled" && i + 1 < argc) {
+			compiled_grammar_file = argv[++i];
+		} else if (argument == "--threads" && i + 1 < argc) {
+			// parsed as signed, so -1 isn't wrapped to a huge unsigned number
+			string value = argv[++i];
+			long long parsed_threads_number = -1;
+			size_t parsed_length = 0;
+			try {
+				parsed_threads_number = std::stoll(value, &parsed_length);
+			} catch (const std::exception&) {
+			}
+			if (parsed_length != value.size() || parsed_threads_number < 0 ||
+					parsed_threads_number > numeric_limits<unsigned>::max()) {
+				printUsage();
+				return 1;
+			}
+			threads_number = parsed_threads_number;
+		} else if (argument == "--lexer" && i + 1 < argc) {
+			string lexer_name = argv[++i];
+			if (lexer_name == "characters") {
+				lexer = nullptr;
+			} else if (lexer_name == "words") {
+				lexer = &whitespace_lexer;
+			} else if (lexer_name == "longest") {
+				lexer = &longest_match_lexer;
+			} else {
+				printUsage();
+				return 1;
+			}
+		} else if (argument[0] != '-' && input_file.empty()) {
+			input_file = argument;
+		} else {
+			printUsage();
+			return 1;
+		}
+	}
+	// the file argument is the inputs of --batch and the output of --compile
+	if (batch == compile || (compile && (input_file.empty() || !compiled_grammar_file.empty()))) {
+		printUsage();
+		return 1;
+	}
+	try {
+		if (compile) {
+			return compileGrammar(grammar_file, input_file);
+		}
+		return recognizeBatch(grammar_file, compiled_grammar_file, input_file, threads_number, lexer);
+	} catch (const runtime_error& error) {
+		cerr << error.what() << endl;
+		return 1;
+	}
 }
 
 /*
@@ -0,0 +1,530 @@
+#include "normalization.h"
+#include "symbol_table.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+using std::runtime_error;
+using std::to_string;
+
+namespace {
+
+// the grammar over interned symbols, rules as flat int arrays as in CompiledGrammar;
+// epsilon rules have empty right sides. The passes work on it, so a pipeline
+// converts from strings and back once
+class IndexedGrammar {
+public:
+	explicit IndexedGrammar(const Grammar& grammar);
+	Grammar toGrammar() const;
+	GrammarSize size() const;
+	// the same symbols without rules
+	IndexedGrammar withoutRules() const;
+
+	bool isNonterminal(int symbol) const {
+		return !symbols.isTerminal(symbol);
+	}
+	int rulesNumber() const {
+		return rule_from_.size();
+	}
+	int ruleFrom(int rule_number) const {
+		return rule_from_[rule_number];
+	}
+	// the right side of rule r is [ruleBegin(r), ruleEnd(r))
+	const int* ruleBegin(int rule_number) const {
+		return rule_symbols_.data() + rule_begin_[rule_number];
+	}
+	const int* ruleEnd(int rule_number) const {
+		return rule_symbols_.data() + rule_begin_[rule_number + 1];
+	}
+	int ruleLength(int rule_number) const {
+		return rule_begin_[rule_number + 1] - rule_begin_[rule_number];
+	}
+	// repeated rules are skipped
+	void addRule(int from, const int* begin, const int* end);
+	void addRule(int from, const vector<int>& to) {
+		addRule(from, to.data(), to.data() + to.size());
+	}
+
+	SymbolTable symbols;
+	int start;
+
+private:
+	IndexedGrammar() = default;
+	size_t hash_(int from, const int* begin, const int* end) const;
+	bool isRule_(int rule_number, int from, const int* begin, const int* end) const;
+	void rehash_();
+
+	vector<int> rule_from_;
+	vector<uint32_t> rule_begin_ = {0};
+	vector<int> rule_symbols_;
+	// open addressing over the rule numbers, -1 for free slots; a power of two
+	// at least twice as big as the number of rules
+	vector<int> rule_slots_;
+};
+
+IndexedGrammar::IndexedGrammar(const Grammar& grammar) {
+	start = symbols.intern(grammar.starting_symbol);
+	vector<int> to;
+	for (const Rule& rule : grammar.rules) {
+		to.clear();
+		for (const string& symbol : rule.to) {
+			if (symbol != "epsilon") {
+				to.push_back(symbols.intern(symbol));
+			}
+		}
+		addRule(symbols.intern(rule.from), to);
+	}
+}
+
+Grammar IndexedGrammar::toGrammar() const {
+	Grammar grammar;
+	grammar.setStartingSymbol(symbols.name(start));
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		Rule rule{symbols.name(rule_from_[rule_number]), {}};
+		for (const int* symbol = ruleBegin(rule_number); symbol != ruleEnd(rule_number); ++symbol) {
+			rule.to.push_back(symbols.name(*symbol));
+		}
+		if (rule.to.empty()) {
+			rule.to.push_back("epsilon");
+		}
+		grammar.addRule(rule);
+	}
+	return grammar;
+}
+
+GrammarSize IndexedGrammar::size() const {
+	// the nonterminals of Grammar are those of the rules and the starting symbol
+	vector<bool> is_used(symbols.size(), false);
+	is_used[start] = true;
+	for (int from : rule_from_) {
+		is_used[from] = true;
+	}
+	for (int symbol : rule_symbols_) {
+		is_used[symbol] = true;
+	}
+	GrammarSize size{rule_from_.size(), 0, rule_from_.size() + rule_symbols_.size()};
+	for (int symbol = 0; symbol < symbols.size(); ++symbol) {
+		size.nonterminals_number += is_used[symbol] && isNonterminal(symbol);
+	}
+	return size;
+}
+
+IndexedGrammar IndexedGrammar::withoutRules() const {
+	IndexedGrammar grammar;
+	grammar.symbols = symbols;
+	grammar.start = start;
+	return grammar;
+}
+
+size_t IndexedGrammar::hash_(int from, const int* begin, const int* end) const {
+	size_t hash = from;
+	for (const int* symbol = begin; symbol != end; ++symbol) {
+		hash = hash * 1000003 + *symbol;
+	}
+	return hash ^ (hash >> 29);
+}
+
+bool IndexedGrammar::isRule_(int rule_number, int from, const int* begin, const int* end) const {
+	return rule_from_[rule_number] == from && ruleLength(rule_number) == end - begin &&
+			std::equal(begin, end, ruleBegin(rule_number));
+}
+
+void IndexedGrammar::rehash_() {
+	rule_slots_.assign(std::max<size_t>(16, 4 * rule_from_.size()), -1);
+	size_t mask = rule_slots_.size() - 1;
+	for (int rule_number = 0; rule_number < rulesNumber(); ++rule_number) {
+		size_t slot = hash_(rule_from_[rule_number], ruleBegin(rule_number), ruleEnd(rule_number)) & mask;
+		while (rule_slots_[slot] != -1) {
+			slot = (slot + 1) & mask;
+		}
+		rule_slots_[slot] = rule_number;
+	}
+}
+
+void IndexedGrammar::addRule(int from, const int* begin, const int* end) {
+	if (2 * (rule_from_.size() + 1) > rule_slots_.size()) {
+		rehash_();
+	}
+	size_t mask = rule_slots_.size() - 1;
+	size_t slot = hash_(from, begin, end) & mask;
+	for (; rule_slots_[slot] != -1; slot = (slot + 1) & mask) {
+		if (isRule_(rule_slots_[slot], from, begin, end)) {
+			return;
+		}
+	}
+	rule_slots_[slot] = rule_from_.size();
+	rule_from_.push_back(from);
+	rule_symbols_.insert(rule_symbols_.end(), begin, end);
+	rule_begin_.push_back(rule_symbols_.size());
+}
+
+// names of new nonterminals: the base with a number, unused in the grammar
+class FreshNames {
+public:
+	explicit FreshNames(IndexedGrammar& grammar) : grammar_(grammar) {}
+	int make(const string& base) {
+		string name;
+		do {
+			name = base + "_" + to_string(++counter_);
+		} while (grammar_.symbols.find(name) != -1);
+		return grammar_.symbols.intern(name);
+	}
+
+private:
+	IndexedGrammar& grammar_;
+	int counter_ = 0;
+};
+
+// a rule derives epsilon (or a word) when all of its symbols do: count the ones
+// not known to do it yet and propagate every symbol found once, as CompiledGrammar does
+vector<bool> propagate(const IndexedGrammar& grammar, vector<bool> found) {
+	int rules_number = grammar.rulesNumber();
+	vector<int> unknown_symbols(rules_number, 0);
+	vector<vector<int>> occurrences(grammar.symbols.size());
+	vector<int> queue;
+	for (int rule_number = 0; rule_number < rules_number; ++rule_number) {
+		for (const int* symbol = grammar.ruleBegin(rule_number); symbol != grammar.ruleEnd(rule_number); ++symbol) {
+			if (!found[*symbol]) {
+				++unknown_symbols[rule_number];
+				occurrences[*symbol].push_back(rule_number);
+			}
+		}
+		int from = grammar.ruleFrom(rule_number);
+		if (unknown_symbols[rule_number] == 0 && !found[from]) {
+			found[from] = true;
+			queue.push_back(from);
+		}
+	}
+	for (size_t queue_position = 0; queue_position < queue.size(); ++queue_position) {
+		for (int rule_number : occurrences[queue[queue_position]]) {
+			int from = grammar.ruleFrom(rule_number);
+			if (--unknown_symbols[rule_number] == 0 && !found[from]) {
+				found[from] = true;
+				queue.push_back(from);
+			}
+		}
+	}
+	return found;
+}
+
+vector<bool> nullableSymbols(const IndexedGrammar& grammar) {
+	return propagate(grammar, vector<bool>(grammar.symbols.size(), false));
+}
+
+IndexedGrammar removeUselessSymbols(const IndexedGrammar& grammar) {
+	int symbols_number = grammar.symbols.size();
+	vector<bool> terminals(symbols_number, false);
+	for (int symbol = 0; symbol < symbols_number; ++symbol) {
+		terminals[symbol] = !grammar.isNonterminal(symbol);
+	}
+	vector<bool> productive = propagate(grammar, terminals);
+	auto isProductiveRule = [&](int rule_number) {
+		return std::all_of(grammar.ruleBegin(rule_number), grammar.ruleEnd(rule_number),
+				[&](int symbol) { return productive[symbol]; });
+	};
+
+	// reachable symbols over the productive rules only
+	vector<vector<int>> rules_of(symbols_number);
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		if (isProductiveRule(rule_number)) {
+			rules_of[grammar.ruleFrom(rule_number)].push_back(rule_number);
+		}
+	}
+	vector<bool> reachable(symbols_number, false);
+	vector<int> queue;
+	if (productive[grammar.start]) {
+		reachable[grammar.start] = true;
+		queue.push_back(grammar.start);
+	}
+	for (size_t queue_position = 0; queue_position < queue.size(); ++queue_position) {
+		for (int rule_number : rules_of[queue[queue_position]]) {
+			for (const int* symbol = grammar.ruleBegin(rule_number); symbol != grammar.ruleEnd(rule_number); ++symbol) {
+				if (!reachable[*symbol]) {
+					reachable[*symbol] = true;
+					queue.push_back(*symbol);
+				}
+			}
+		}
+	}
+
+	IndexedGrammar result_grammar = grammar.withoutRules();
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		if (reachable[grammar.ruleFrom(rule_number)] && isProductiveRule(rule_number)) {
+			result_grammar.addRule(grammar.ruleFrom(rule_number), grammar.ruleBegin(rule_number),
+					grammar.ruleEnd(rule_number));
+		}
+	}
+	return result_grammar;
+}
+
+IndexedGrammar binarize(const IndexedGrammar& grammar) {
+	IndexedGrammar result_grammar = grammar.withoutRules();
+	FreshNames fresh_names(result_grammar);
+	// T_k--->a for the terminals of long right sides, one per terminal
+	vector<int> terminal_nonterminals(grammar.symbols.size(), -1);
+	vector<int> to;
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		int from = grammar.ruleFrom(rule_number);
+		if (grammar.ruleLength(rule_number) < 2) {
+			result_grammar.addRule(from, grammar.ruleBegin(rule_number), grammar.ruleEnd(rule_number));
+			continue;
+		}
+		to.clear();
+		for (const int* symbol = grammar.ruleBegin(rule_number); symbol != grammar.ruleEnd(rule_number); ++symbol) {
+			if (grammar.isNonterminal(*symbol)) {
+				to.push_back(*symbol);
+				continue;
+			}
+			if (terminal_nonterminals[*symbol] == -1) {
+				terminal_nonterminals[*symbol] = fresh_names.make("T");
+				result_grammar.addRule(terminal_nonterminals[*symbol], {*symbol});
+			}
+			to.push_back(terminal_nonterminals[*symbol]);
+		}
+		// A--->X1 X2 ... Xk is A--->X1 A_1, A_1--->X2 A_2, ..., A_(k-2)--->X(k-1) Xk
+		for (size_t i = 0; i + 2 < to.size(); ++i) {
+			int next = fresh_names.make(grammar.symbols.name(grammar.ruleFrom(rule_number)));
+			result_grammar.addRule(from, {to[i], next});
+			from = next;
+		}
+		result_grammar.addRule(from, {to[to.size() - 2], to.back()});
+	}
+	return result_grammar;
+}
+
+// 2^20 rules are made of a rule with that many nullable symbols
+const size_t max_nullable_symbols = 20;
+
+IndexedGrammar removeEpsilonRules(const IndexedGrammar& grammar) {
+	vector<bool> nullable = nullableSymbols(grammar);
+	IndexedGrammar result_grammar = grammar.withoutRules();
+	if (nullable[grammar.start]) {
+		bool start_is_used = false;
+		for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+			start_is_used = start_is_used || std::find(grammar.ruleBegin(rule_number),
+					grammar.ruleEnd(rule_number), grammar.start) != grammar.ruleEnd(rule_number);
+		}
+		if (start_is_used) {
+			FreshNames fresh_names(result_grammar);
+			result_grammar.start = fresh_names.make(grammar.symbols.name(grammar.start));
+			result_grammar.addRule(result_grammar.start, {grammar.start});
+		}
+		result_grammar.addRule(result_grammar.start, {});
+	}
+
+	vector<int> nullable_positions;
+	vector<int> to;
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		int from = grammar.ruleFrom(rule_number);
+		const int* rule_to = grammar.ruleBegin(rule_number);
+		int length = grammar.ruleLength(rule_number);
+		nullable_positions.clear();
+		for (int i = 0; i < length; ++i) {
+			if (nullable[rule_to[i]]) {
+				nullable_positions.push_back(i);
+			}
+		}
+		if (nullable_positions.size() > max_nullable_symbols) {
+			throw runtime_error("a rule of " + grammar.symbols.name(from) +
+					" has too many nullable symbols, binarize the grammar first");
+		}
+		// every subset of the nullable symbols is dropped, but not all of the symbols
+		for (uint32_t mask = 0; mask < (uint32_t(1) << nullable_positions.size()); ++mask) {
+			to.clear();
+			size_t j = 0;
+			for (int i = 0; i < length; ++i) {
+				if (j < nullable_positions.size() && nullable_positions[j] == i) {
+					if ((mask >> j++) & 1) {
+						continue;
+					}
+				}
+				to.push_back(rule_to[i]);
+			}
+			if (to.empty() || (to.size() == 1 && to[0] == from)) {
+				continue;
+			}
+			result_grammar.addRule(from, to);
+		}
+	}
+	return result_grammar;
+}
+
+// the unit rules A--->B of a nonterminal A which is in one right side only,
+// P--->X A or P--->A X, become rules P--->X B: this doesn't add rules, while
+// replacing A--->B would copy all of the rules of B to A. Epsilon removal makes
+// such unit rules of the nonterminals added by binarization
+IndexedGrammar inlineUnitRules(const IndexedGrammar& grammar) {
+	int symbols_number = grammar.symbols.size();
+	vector<int> occurrences_number(symbols_number, 0);
+	vector<int> occurrence_rule(symbols_number, -1);
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		for (const int* symbol = grammar.ruleBegin(rule_number); symbol != grammar.ruleEnd(rule_number); ++symbol) {
+			++occurrences_number[*symbol];
+			occurrence_rule[*symbol] = rule_number;
+		}
+	}
+	vector<vector<int>> unit_successors(symbols_number);
+	vector<bool> has_other_rules(symbols_number, false);
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		int from = grammar.ruleFrom(rule_number);
+		if (grammar.ruleLength(rule_number) == 1 && grammar.isNonterminal(*grammar.ruleBegin(rule_number))) {
+			unit_successors[from].push_back(*grammar.ruleBegin(rule_number));
+		} else {
+			has_other_rules[from] = true;
+		}
+	}
+	vector<bool> is_inlined(symbols_number, false);
+	for (int A = 0; A < symbols_number; ++A) {
+		is_inlined[A] = A != grammar.start && !unit_successors[A].empty() && occurrences_number[A] == 1 &&
+				grammar.ruleLength(occurrence_rule[A]) == 2 && grammar.ruleFrom(occurrence_rule[A]) != A;
+	}
+
+	IndexedGrammar result_grammar = grammar.withoutRules();
+	// the symbols which can stand in place of a symbol of a rule
+	auto replacements = [&](int symbol) {
+		vector<int> symbols;
+		if (!is_inlined[symbol] || has_other_rules[symbol]) {
+			symbols.push_back(symbol);
+		}
+		if (is_inlined[symbol]) {
+			symbols.insert(symbols.end(), unit_successors[symbol].begin(), unit_successors[symbol].end());
+		}
+		return symbols;
+	};
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		int from = grammar.ruleFrom(rule_number);
+		const int* to = grammar.ruleBegin(rule_number);
+		if (is_inlined[from] && grammar.ruleLength(rule_number) == 1 && grammar.isNonterminal(to[0])) {
+			continue;
+		}
+		if (grammar.ruleLength(rule_number) != 2 || (!is_inlined[to[0]] && !is_inlined[to[1]])) {
+			result_grammar.addRule(from, to, grammar.ruleEnd(rule_number));
+			continue;
+		}
+		for (int first : replacements(to[0])) {
+			for (int second : replacements(to[1])) {
+				result_grammar.addRule(from, {first, second});
+			}
+		}
+	}
+	return result_grammar;
+}
+
+IndexedGrammar removeUnitRules(const IndexedGrammar& input_grammar) {
+	IndexedGrammar grammar = inlineUnitRules(input_grammar);
+	int symbols_number = grammar.symbols.size();
+	vector<vector<int>> unit_successors(symbols_number);
+	vector<vector<int>> rules_of(symbols_number); // the rules which aren't unit rules
+	for (int rule_number = 0; rule_number < grammar.rulesNumber(); ++rule_number) {
+		int from = grammar.ruleFrom(rule_number);
+		if (grammar.ruleLength(rule_number) == 1 && grammar.isNonterminal(*grammar.ruleBegin(rule_number))) {
+			unit_successors[from].push_back(*grammar.ruleBegin(rule_number));
+		} else {
+			rules_of[from].push_back(rule_number);
+		}
+	}
+
+	IndexedGrammar result_grammar = grammar.withoutRules();
+	// only the nonterminals reachable from the start by the new rules get them:
+	// a nonterminal reached by unit rules only is unreachable without them
+	vector<bool> is_reachable(symbols_number, false);
+	vector<int> reachable = {grammar.start};
+	is_reachable[grammar.start] = true;
+	// the nonterminals B with A--->...--->B by unit rules, stamped by A
+	vector<int> reached_from(symbols_number, -1);
+	vector<int> queue;
+	for (size_t reachable_position = 0; reachable_position < reachable.size(); ++reachable_position) {
+		int A = reachable[reachable_position];
+		queue.assign(1, A);
+		reached_from[A] = A;
+		for (size_t queue_position = 0; queue_position < queue.size(); ++queue_position) {
+			int B = queue[queue_position];
+			for (int rule_number : rules_of[B]) {
+				result_grammar.addRule(A, grammar.ruleBegin(rule_number), grammar.ruleEnd(rule_number));
+				for (const int* symbol = grammar.ruleBegin(rule_number); symbol != grammar.ruleEnd(rule_number); ++symbol) {
+					if (grammar.isNonterminal(*symbol) && !is_reachable[*symbol]) {
+						is_reachable[*symbol] = true;
+						reachable.push_back(*symbol);
+					}
+				}
+			}
+			for (int C : unit_successors[B]) {
+				if (reached_from[C] != A) {
+					reached_from[C] = A;
+					queue.push_back(C);
+				}
+			}
+		}
+	}
+	return result_grammar;
+}
+
+} // namespace
+
+GrammarSize grammarSize(const Grammar& grammar) {
+	GrammarSize size{grammar.rules.size(), grammar.symbols.size(), 0};
+	for (const Rule& rule : grammar.rules) {
+		size.length += 1 + rule.to.size();
+		if (rule.to.size() == 1 && rule.to[0] == "epsilon") {
+			--size.length;
+		}
+	}
+	return size;
+}
+
+ostream& operator << (ostream& os, const GrammarSize& size) {
+	return os << size.rules_number << " rules, " << size.nonterminals_number << " nonterminals, length "
+			<< size.length;
+}
+
+unordered_set<string> findNullableSymbols(const Grammar& grammar) {
+	IndexedGrammar indexed_grammar(grammar);
+	vector<bool> nullable = nullableSymbols(indexed_grammar);
+	unordered_set<string> nullable_symbols;
+	for (int symbol = 0; symbol < indexed_grammar.symbols.size(); ++symbol) {
+		if (nullable[symbol]) {
+			nullable_symbols.insert(indexed_grammar.symbols.name(symbol));
+		}
+	}
+	return nullable_symbols;
+}
+
+Grammar removeUselessSymbols(const Grammar& grammar) {
+	return removeUselessSymbols(IndexedGrammar(grammar)).toGrammar();
+}
+
+Grammar binarize(const Grammar& grammar) {
+	return binarize(IndexedGrammar(grammar)).toGrammar();
+}
+
+Grammar removeEpsilonRules(const Grammar& grammar) {
+	return removeEpsilonRules(IndexedGrammar(grammar)).toGrammar();
+}
+
+Grammar removeUnitRules(const Grammar& grammar) {
+	return removeUnitRules(IndexedGrammar(grammar)).toGrammar();
+}
+
+Grammar toChomskyForm(const Grammar& grammar, vector<pair<string, GrammarSize>>* pass_sizes) {
+	IndexedGrammar result_grammar(grammar);
+	auto record = [&](const string& pass_name) {
+		if (pass_sizes != nullptr) {
+			pass_sizes->push_back({pass_name, result_grammar.size()});
+		}
+	};
+	record("input");
+	// useless symbols go first too, so that the other passes don't work on them
+	result_grammar = removeUselessSymbols(result_grammar);
+	record("removing useless symbols");
+	result_grammar = binarize(result_grammar);
+	record("binarization");
+	result_grammar = removeEpsilonRules(result_grammar);
+	record("removing epsilon rules");
+	result_grammar = removeUnitRules(result_grammar);
+	record("removing unit rules");
+	// epsilon removal leaves the nonterminals deriving only epsilon unproductive
+	result_grammar = removeUselessSymbols(result_grammar);
+	record("removing useless symbols");
+	return result_grammar.toGrammar();
+}
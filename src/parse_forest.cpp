@@ -0,0 +1,177 @@
+#include "parse_forest.h"
+
+#include <algorithm>
+#include <tuple>
+
+// nodes are made from the chart when they are first referred to and are expanded
+// in the order they were made, so the packed nodes of a node are added together
+class ParseForest::Builder {
+public:
+	Builder(const CompiledGrammar& grammar, const Chart& chart, ParseForest& forest);
+	void build();
+
+private:
+	// completed situations sorted by the symbol node they derive
+	struct Completion {
+		uint32_t end;
+		int symbol;
+		uint32_t begin;
+		uint32_t position;
+	};
+	static bool precedes(const Completion& c1, const Completion& c2) {
+		return std::tie(c1.end, c1.symbol, c1.begin) < std::tie(c2.end, c2.symbol, c2.begin);
+	}
+
+	int addNode_(int symbol, uint32_t item, uint32_t begin, uint32_t end, uint32_t source);
+	int leafNode_(int terminal, uint32_t begin);
+	int symbolNode_(int symbol, uint32_t begin, uint32_t end);
+	int intermediateNode_(uint32_t position);
+	// the node of the symbols before the dot of the situation
+	int prefixNode_(uint32_t position);
+	// the node of the symbol after the dot of the situation, which ends at end
+	int nextSymbolNode_(uint32_t position, uint32_t end);
+	void addLinkedNodes_(uint32_t position);
+	void expand_(int node_number);
+
+	const CompiledGrammar& grammar_;
+	const Chart& chart_;
+	ParseForest& forest_;
+
+	vector<uint32_t> column_of_; // by position
+	vector<Completion> completions_;
+	vector<int> completion_nodes_; // node of the completions starting at the index
+	vector<int> leaf_nodes_; // by the first token of the span
+	vector<int> intermediate_nodes_; // by position
+	// what a node is made from: its first completion or its position
+	vector<uint32_t> sources_;
+};
+
+ParseForest::ParseForest(const CompiledGrammar& grammar, const Chart& chart) {
+	Builder(grammar, chart, *this).build();
+}
+
+ParseForest::Builder::Builder(const CompiledGrammar& grammar, const Chart& chart,
+		ParseForest& forest) : grammar_(grammar), chart_(chart), forest_(forest) {
+	// without edits the columns are adjacent and in order
+	uint32_t columns_number = chart.columnsNumber();
+	uint32_t positions_number = chart.columnEnd(columns_number - 1);
+	column_of_.resize(positions_number);
+	for (uint32_t d = 0; d < columns_number; ++d) {
+		for (uint32_t k = chart.columnBegin(d); k < chart.columnEnd(d); ++k) {
+			column_of_[k] = d;
+			if (grammar.itemNextSymbol(chart.item(k)) == -1) {
+				int symbol = grammar.ruleFrom(grammar.itemRule(chart.item(k)));
+				completions_.push_back(Completion{d, symbol, chart.origin(k), k});
+			}
+		}
+	}
+	std::stable_sort(completions_.begin(), completions_.end(), precedes);
+	completion_nodes_.assign(completions_.size(), none);
+	leaf_nodes_.assign(columns_number, none);
+	intermediate_nodes_.assign(positions_number, none);
+}
+
+void ParseForest::Builder::build() {
+	int start_symbol = grammar_.ruleSymbol(grammar_.startRule(), 0);
+	int root = symbolNode_(start_symbol, 0, chart_.columnsNumber() - 1);
+	if (forest_.nodes_[root].symbol != start_symbol || sources_[root] == Chart::npos) {
+		forest_.nodes_.clear();
+		sources_.clear();
+		return;
+	}
+	forest_.root_ = root;
+	for (int node_number = 0; node_number < forest_.nodesNumber(); ++node_number) {
+		expand_(node_number);
+	}
+}
+
+int ParseForest::Builder::addNode_(int symbol, uint32_t item, uint32_t begin, uint32_t end,
+		uint32_t source) {
+	forest_.nodes_.push_back(Node{symbol, item, begin, end, 0, 0});
+	sources_.push_back(source);
+	return forest_.nodes_.size() - 1;
+}
+
+int ParseForest::Builder::leafNode_(int terminal, uint32_t begin) {
+	if (leaf_nodes_[begin] == none) {
+		leaf_nodes_[begin] = addNode_(terminal, 0, begin, begin + 1, Chart::npos);
+	}
+	return leaf_nodes_[begin];
+}
+
+int ParseForest::Builder::symbolNode_(int symbol, uint32_t begin, uint32_t end) {
+	auto first = std::lower_bound(completions_.begin(), completions_.end(),
+			Completion{end, symbol, begin, 0}, precedes);
+	if (first == completions_.end() || precedes(Completion{end, symbol, begin, 0}, *first)) {
+		// only the root may be missing, when the input isn't recognized
+		return addNode_(symbol, 0, begin, end, Chart::npos);
+	}
+	int& node_number = completion_nodes_[first - completions_.begin()];
+	if (node_number == none) {
+		node_number = addNode_(symbol, 0, begin, end, first - completions_.begin());
+	}
+	return node_number;
+}
+
+int ParseForest::Builder::intermediateNode_(uint32_t position) {
+	if (intermediate_nodes_[position] == none) {
+		intermediate_nodes_[position] = addNode_(none, chart_.item(position), chart_.origin(position),
+				column_of_[position], position);
+	}
+	return intermediate_nodes_[position];
+}
+
+int ParseForest::Builder::prefixNode_(uint32_t position) {
+	uint32_t item = chart_.item(position);
+	int rule_number = grammar_.itemRule(item);
+	uint32_t dot = item - grammar_.ruleFirstItem(rule_number);
+	if (dot == 0) {
+		return none;
+	}
+	if (dot >= 2) {
+		return intermediateNode_(position);
+	}
+	int symbol = grammar_.ruleSymbol(rule_number, 0);
+	if (grammar_.isTerminal(symbol)) {
+		return leafNode_(symbol, chart_.origin(position));
+	}
+	return symbolNode_(symbol, chart_.origin(position), column_of_[position]);
+}
+
+int ParseForest::Builder::nextSymbolNode_(uint32_t position, uint32_t end) {
+	int symbol = grammar_.itemNextSymbol(chart_.item(position));
+	if (grammar_.isTerminal(symbol)) {
+		return leafNode_(symbol, column_of_[position]);
+	}
+	return symbolNode_(symbol, column_of_[position], end);
+}
+
+void ParseForest::Builder::addLinkedNodes_(uint32_t position) {
+	uint32_t item = chart_.item(position);
+	if (grammar_.ruleLength(grammar_.itemRule(item)) == 0) {
+		forest_.packed_nodes_.push_back(PackedNode{item, chart_.origin(position), none, none});
+		return;
+	}
+	for (uint32_t link = chart_.firstLink(position); link != Chart::npos;
+			link = chart_.nextLink(link)) {
+		uint32_t predecessor = chart_.linkPredecessor(link);
+		int left = prefixNode_(predecessor);
+		int right = nextSymbolNode_(predecessor, column_of_[position]);
+		forest_.packed_nodes_.push_back(PackedNode{item, column_of_[predecessor], left, right});
+	}
+}
+
+void ParseForest::Builder::expand_(int node_number) {
+	uint32_t packed_begin = forest_.packed_nodes_.size();
+	uint32_t source = sources_[node_number];
+	if (forest_.nodes_[node_number].symbol == none) {
+		addLinkedNodes_(source);
+	} else if (source != Chart::npos) {
+		for (uint32_t i = source; i < completions_.size() &&
+				!precedes(completions_[source], completions_[i]); ++i) {
+			addLinkedNodes_(completions_[i].position);
+		}
+	}
+	forest_.nodes_[node_number].packed_begin = packed_begin;
+	forest_.nodes_[node_number].packed_end = forest_.packed_nodes_.size();
+}
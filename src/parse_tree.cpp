@@ -0,0 +1,457 @@
+#include "parse_tree.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+using std::pair;
+using std::runtime_error;
+
+namespace {
+
+const int none = ParseForest::none;
+
+// strongly connected components of the forest by Tarjan's algorithm, without recursion
+// as forests of long inputs are deep. Nodes are put to order component by component,
+// the components of the children before the ones of their parents
+void findComponents(const ParseForest& forest, vector<int>& components,
+		vector<bool>& cyclic_components, vector<int>& order) {
+	int nodes_number = forest.nodesNumber();
+	vector<int> index(nodes_number, -1);
+	vector<int> low_link(nodes_number);
+	vector<bool> on_stack(nodes_number, false);
+	vector<bool> has_loop(nodes_number, false);
+	vector<int> stack;
+	vector<pair<int, uint32_t>> calls; // a node with the number of its next edge
+	int counter = 0;
+	components.assign(nodes_number, -1);
+	cyclic_components.clear();
+	order.clear();
+
+	auto visit = [&](int node_number) {
+		index[node_number] = low_link[node_number] = counter++;
+		stack.push_back(node_number);
+		on_stack[node_number] = true;
+		calls.push_back({node_number, 0});
+	};
+	for (int root = 0; root < nodes_number; ++root) {
+		if (index[root] != -1) {
+			continue;
+		}
+		visit(root);
+		while (!calls.empty()) {
+			int v = calls.back().first;
+			uint32_t edge = calls.back().second;
+			const ParseForest::Node& node = forest.node(v);
+			// every packed node has two edges, to its left and right children
+			if (edge < 2 * (node.packed_end - node.packed_begin)) {
+				++calls.back().second;
+				const ParseForest::PackedNode& packed = forest.packedNode(node.packed_begin + edge / 2);
+				int w = edge % 2 == 0 ? packed.left : packed.right;
+				if (w == none) {
+					continue;
+				}
+				if (w == v) {
+					has_loop[v] = true;
+				}
+				if (index[w] == -1) {
+					visit(w);
+				} else if (on_stack[w]) {
+					low_link[v] = std::min(low_link[v], index[w]);
+				}
+				continue;
+			}
+			calls.pop_back();
+			if (!calls.empty()) {
+				int u = calls.back().first;
+				low_link[u] = std::min(low_link[u], low_link[v]);
+			}
+			if (low_link[v] != index[v]) {
+				continue;
+			}
+			int component = cyclic_components.size();
+			cyclic_components.push_back(stack.back() != v || has_loop[v]);
+			int w;
+			do {
+				w = stack.back();
+				stack.pop_back();
+				on_stack[w] = false;
+				components[w] = component;
+				order.push_back(w);
+			} while (w != v);
+		}
+	}
+}
+
+uint64_t saturatedSum(uint64_t a, uint64_t b) {
+	return a > many_trees - b ? many_trees : a + b;
+}
+
+uint64_t saturatedProduct(uint64_t a, uint64_t b) {
+	if (a == 0 || b == 0) {
+		return 0;
+	}
+	return a > many_trees / b ? many_trees : a * b;
+}
+
+} // namespace
+
+double ParseTree::cost(const vector<double>& rule_costs) const {
+	double cost = 0;
+	for (const Node& node : nodes_) {
+		if (node.rule != -1) {
+			cost += rule_costs[node.rule];
+		}
+	}
+	return cost;
+}
+
+void ParseTree::print(ostream& os, const CompiledGrammar& grammar) const {
+	if (nodes_.empty()) {
+		return;
+	}
+	// nodes with their next child to print
+	vector<pair<int, uint32_t>> stack;
+	os << grammar.symbols().name(nodes_[0].symbol);
+	if (nodes_[0].rule == -1) {
+		return;
+	}
+	os << "(";
+	stack.push_back({0, nodes_[0].children_begin});
+	while (!stack.empty()) {
+		const Node& node = nodes_[stack.back().first];
+		uint32_t i = stack.back().second;
+		if (i == node.children_end) {
+			os << ")";
+			stack.pop_back();
+			continue;
+		}
+		++stack.back().second;
+		if (i != node.children_begin) {
+			os << " ";
+		}
+		const Node& child = nodes_[children_[i]];
+		os << grammar.symbols().name(child.symbol);
+		if (child.rule != -1) {
+			os << "(";
+			stack.push_back({children_[i], child.children_begin});
+		}
+	}
+}
+
+void ParseTree::clear() {
+	nodes_.clear();
+	parents_.clear();
+	children_.clear();
+}
+
+void ParseTree::addNode(int symbol, int rule, uint32_t begin, uint32_t end, int parent) {
+	nodes_.push_back(Node{symbol, rule, begin, end, 0, 0});
+	parents_.push_back(parent);
+}
+
+void ParseTree::finish() {
+	// nodes are in preorder, so the children of a node are in order of their numbers
+	for (Node& node : nodes_) {
+		node.children_begin = node.children_end = 0;
+	}
+	for (size_t i = 1; i < nodes_.size(); ++i) {
+		++nodes_[parents_[i]].children_end;
+	}
+	uint32_t children_number = 0;
+	for (Node& node : nodes_) {
+		uint32_t node_children_number = node.children_end;
+		node.children_begin = node.children_end = children_number;
+		children_number += node_children_number;
+	}
+	children_.resize(children_number);
+	for (size_t i = 1; i < nodes_.size(); ++i) {
+		children_[nodes_[parents_[i]].children_end++] = i;
+	}
+}
+
+uint64_t countTrees(const ParseForest& forest) {
+	if (forest.root() == none) {
+		return 0;
+	}
+	vector<int> components;
+	vector<bool> cyclic_components;
+	vector<int> order;
+	findComponents(forest, components, cyclic_components, order);
+	vector<uint64_t> counts(forest.nodesNumber());
+	for (int node_number : order) {
+		const ParseForest::Node& node = forest.node(node_number);
+		if (cyclic_components[components[node_number]]) {
+			counts[node_number] = many_trees;
+			continue;
+		}
+		if (node.packed_begin == node.packed_end) {
+			counts[node_number] = 1;
+			continue;
+		}
+		uint64_t count = 0;
+		for (uint32_t i = node.packed_begin; i < node.packed_end; ++i) {
+			const ParseForest::PackedNode& packed = forest.packedNode(i);
+			uint64_t left_count = packed.left == none ? 1 : counts[packed.left];
+			uint64_t right_count = packed.right == none ? 1 : counts[packed.right];
+			count = saturatedSum(count, saturatedProduct(left_count, right_count));
+		}
+		counts[node_number] = count;
+	}
+	return counts[forest.root()];
+}
+
+TreeEnumerator::TreeEnumerator(const CompiledGrammar& grammar, const ParseForest& forest) :
+		grammar_(grammar), forest_(forest) {
+	vector<int> order;
+	findComponents(forest, components_, cyclic_components_, order);
+}
+
+bool TreeEnumerator::next(ParseTree& tree) {
+	if (!started_) {
+		started_ = true;
+		if (forest_.root() == none) {
+			return false;
+		}
+		pending_.push_back(Pending{forest_.root(), -1, false});
+	} else if (!backtrack_()) {
+		return false;
+	}
+	while (!expand_()) {
+		if (!backtrack_()) {
+			steps_.clear();
+			return false;
+		}
+	}
+	buildTree_(tree);
+	return true;
+}
+
+bool TreeEnumerator::isAcyclic_(int step_number, uint32_t packed) const {
+	// a path leaving a component never comes back to it, so only the ancestors
+	// in the component of the step have to be looked at
+	int component = components_[steps_[step_number].node];
+	if (!cyclic_components_[component]) {
+		return true;
+	}
+	const ParseForest::PackedNode& packed_node = forest_.packedNode(packed);
+	for (int child : {packed_node.left, packed_node.right}) {
+		if (child == none || components_[child] != component) {
+			continue;
+		}
+		for (int i = step_number; i != -1 && components_[steps_[i].node] == component; i = steps_[i].parent) {
+			if (steps_[i].node == child) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+uint32_t TreeEnumerator::nextAlternative_(int step_number, uint32_t packed) const {
+	const ParseForest::Node& node = forest_.node(steps_[step_number].node);
+	for (; packed < node.packed_end; ++packed) {
+		if (isAcyclic_(step_number, packed)) {
+			return packed;
+		}
+	}
+	return npos;
+}
+
+void TreeEnumerator::pushChildren_(int step_number) {
+	// the left child is expanded first
+	const ParseForest::PackedNode& packed = forest_.packedNode(steps_[step_number].packed);
+	if (packed.right != none) {
+		pending_.push_back(Pending{packed.right, step_number, false});
+	}
+	if (packed.left != none) {
+		pending_.push_back(Pending{packed.left, step_number, true});
+	}
+}
+
+bool TreeEnumerator::expand_() {
+	while (!pending_.empty()) {
+		Pending pending = pending_.back();
+		pending_.pop_back();
+		int step_number = steps_.size();
+		steps_.push_back(Step{pending.node, npos, pending.parent, pending.is_left});
+		const ParseForest::Node& node = forest_.node(pending.node);
+		if (node.packed_begin == node.packed_end) {
+			continue;
+		}
+		uint32_t packed = nextAlternative_(step_number, node.packed_begin);
+		if (packed == npos) {
+			steps_.pop_back();
+			return false;
+		}
+		steps_[step_number].packed = packed;
+		pushChildren_(step_number);
+	}
+	return true;
+}
+
+bool TreeEnumerator::backtrack_() {
+	for (int step_number = static_cast<int>(steps_.size()) - 1; step_number >= 0; --step_number) {
+		if (steps_[step_number].packed == npos) {
+			continue;
+		}
+		uint32_t packed = nextAlternative_(step_number, steps_[step_number].packed + 1);
+		if (packed == npos) {
+			continue;
+		}
+		steps_[step_number].packed = packed;
+		steps_.resize(step_number + 1);
+		// after the children of the step come the right siblings of its ancestors,
+		// those of the nearest ancestors first
+		pending_.clear();
+		for (int i = step_number; steps_[i].parent != -1; i = steps_[i].parent) {
+			int right = forest_.packedNode(steps_[steps_[i].parent].packed).right;
+			if (steps_[i].is_left && right != none) {
+				pending_.push_back(Pending{right, steps_[i].parent, false});
+			}
+		}
+		std::reverse(pending_.begin(), pending_.end());
+		pushChildren_(step_number);
+		return true;
+	}
+	return false;
+}
+
+void TreeEnumerator::buildTree_(ParseTree& tree) {
+	// intermediate nodes aren't in the tree, their children are given to their parents
+	tree.clear();
+	tree_nodes_.resize(steps_.size());
+	for (size_t i = 0; i < steps_.size(); ++i) {
+		const Step& step = steps_[i];
+		int parent = step.parent == -1 ? -1 : tree_nodes_[step.parent];
+		const ParseForest::Node& node = forest_.node(step.node);
+		if (node.symbol == none) {
+			tree_nodes_[i] = parent;
+			continue;
+		}
+		int rule = step.packed == npos ? -1 : grammar_.itemRule(forest_.packedNode(step.packed).item);
+		tree_nodes_[i] = tree.nodesNumber();
+		tree.addNode(node.symbol, rule, node.begin, node.end, parent);
+	}
+	tree.finish();
+}
+
+vector<ParseTree> bestTrees(const CompiledGrammar& grammar, const ParseForest& forest,
+		const vector<double>& rule_costs, int k) {
+	// the start rule of the compiled grammar is never in a tree
+	if (static_cast<int>(rule_costs.size()) < grammar.rulesNumber() - 1) {
+		throw runtime_error("every rule needs a cost");
+	}
+	vector<ParseTree> trees;
+	if (forest.root() == none || k <= 0) {
+		return trees;
+	}
+	vector<int> components;
+	vector<bool> cyclic_components;
+	vector<int> order;
+	findComponents(forest, components, cyclic_components, order);
+	if (std::find(cyclic_components.begin(), cyclic_components.end(), true) != cyclic_components.end()) {
+		throw runtime_error("best trees of a cyclic forest");
+	}
+
+	// the k best derivations of every node, children before parents: a derivation is
+	// a packed node with the ranks of the derivations of its children
+	struct Derivation {
+		double cost;
+		uint32_t packed;
+		uint32_t left_rank;
+		uint32_t right_rank;
+	};
+	auto worse = [](const Derivation& d1, const Derivation& d2) {
+		return std::tie(d1.cost, d1.packed, d1.left_rank, d1.right_rank) >
+				std::tie(d2.cost, d2.packed, d2.left_rank, d2.right_rank);
+	};
+	vector<Derivation> derivations;
+	vector<uint32_t> derivations_begin(forest.nodesNumber());
+	vector<uint32_t> derivations_end(forest.nodesNumber());
+	auto derivationsNumber = [&](int node_number) -> uint32_t {
+		return node_number == none ? 1 : derivations_end[node_number] - derivations_begin[node_number];
+	};
+	auto derivationCost = [&](int node_number, uint32_t rank) -> double {
+		return node_number == none ? 0 : derivations[derivations_begin[node_number] + rank].cost;
+	};
+	auto candidate = [&](int node_number, uint32_t packed, uint32_t left_rank, uint32_t right_rank) {
+		const ParseForest::PackedNode& packed_node = forest.packedNode(packed);
+		double cost = derivationCost(packed_node.left, left_rank) + derivationCost(packed_node.right, right_rank);
+		if (forest.node(node_number).symbol != none) {
+			cost += rule_costs[grammar.itemRule(packed_node.item)];
+		}
+		return Derivation{cost, packed, left_rank, right_rank};
+	};
+
+	vector<Derivation> candidates; // a heap
+	for (int node_number : order) {
+		const ParseForest::Node& node = forest.node(node_number);
+		derivations_begin[node_number] = derivations.size();
+		if (node.packed_begin == node.packed_end) {
+			derivations.push_back(Derivation{0, 0, 0, 0});
+			derivations_end[node_number] = derivations.size();
+			continue;
+		}
+		candidates.clear();
+		for (uint32_t packed = node.packed_begin; packed < node.packed_end; ++packed) {
+			candidates.push_back(candidate(node_number, packed, 0, 0));
+		}
+		std::make_heap(candidates.begin(), candidates.end(), worse);
+		// every pair of ranks is a candidate once: (l, r + 1) follows (l, r)
+		// and (l + 1, 0) follows (l, 0)
+		while (!candidates.empty() && derivations.size() - derivations_begin[node_number] < static_cast<uint32_t>(k)) {
+			std::pop_heap(candidates.begin(), candidates.end(), worse);
+			Derivation best = candidates.back();
+			candidates.pop_back();
+			derivations.push_back(best);
+			const ParseForest::PackedNode& packed_node = forest.packedNode(best.packed);
+			if (best.right_rank == 0 && best.left_rank + 1 < derivationsNumber(packed_node.left)) {
+				candidates.push_back(candidate(node_number, best.packed, best.left_rank + 1, 0));
+				std::push_heap(candidates.begin(), candidates.end(), worse);
+			}
+			if (best.right_rank + 1 < derivationsNumber(packed_node.right)) {
+				candidates.push_back(candidate(node_number, best.packed, best.left_rank, best.right_rank + 1));
+				std::push_heap(candidates.begin(), candidates.end(), worse);
+			}
+		}
+		derivations_end[node_number] = derivations.size();
+	}
+
+	struct Task {
+		int node;
+		uint32_t rank;
+		int parent;
+	};
+	vector<Task> tasks;
+	trees.resize(derivationsNumber(forest.root()));
+	for (uint32_t rank = 0; rank < trees.size(); ++rank) {
+		ParseTree& tree = trees[rank];
+		tasks.push_back(Task{forest.root(), rank, -1});
+		while (!tasks.empty()) {
+			Task task = tasks.back();
+			tasks.pop_back();
+			const ParseForest::Node& node = forest.node(task.node);
+			if (node.packed_begin == node.packed_end) {
+				tree.addNode(node.symbol, -1, node.begin, node.end, task.parent);
+				continue;
+			}
+			const Derivation& derivation = derivations[derivations_begin[task.node] + task.rank];
+			const ParseForest::PackedNode& packed_node = forest.packedNode(derivation.packed);
+			int parent = task.parent;
+			if (node.symbol != none) {
+				parent = tree.nodesNumber();
+				tree.addNode(node.symbol, grammar.itemRule(packed_node.item), node.begin, node.end, task.parent);
+			}
+			if (packed_node.right != none) {
+				tasks.push_back(Task{packed_node.right, derivation.right_rank, parent});
+			}
+			if (packed_node.left != none) {
+				tasks.push_back(Task{packed_node.left, derivation.left_rank, parent});
+			}
+		}
+		tree.finish();
+	}
+	return trees;
+}
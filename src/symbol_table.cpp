@@ -0,0 +1,31 @@
+#include "symbol_table.h"
+#include "grammar.h"
+
+int SymbolTable::intern(const string& symbol) {
+	auto insert_result = ids_.insert({symbol, static_cast<int>(names_.size())});
+	if (insert_result.second) {
+		names_.push_back(symbol);
+		is_terminal_.push_back(isAlphabetSymbol(symbol));
+	}
+	return insert_result.first->second;
+}
+
+int SymbolTable::find(const string& symbol) const {
+	auto symbol_iterator = ids_.find(symbol);
+	if (symbol_iterator == ids_.end()) {
+		return -1;
+	}
+	return symbol_iterator->second;
+}
+
+const string& SymbolTable::name(int id) const {
+	return names_[id];
+}
+
+bool SymbolTable::isTerminal(int id) const {
+	return is_terminal_[id];
+}
+
+int SymbolTable::size() const {
+	return names_.size();
+}